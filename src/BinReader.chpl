@@ -12,21 +12,157 @@ use RangeChunk;
 config param DEBUG_BIN_READER = false;
 config const numEdgesPresent = true;
 
-// Reads a binary file into a graph
-proc binToHypergraph(dataset : string) throws {
-  try! {
+// "CHGLCSR\0", the magic number of files with a self-describing header (see
+// test_performance/converters/csr_format.hpp), read as a little-endian uint(64).
+param chglCsrMagic : uint(64) = 0x005253434C474843;
+
+// "CHGLHYP\0", the magic number of hypergraph files that hold both incidence
+// directions, written by test_performance/converters/hypergraph-converter.
+param chglHypergraphMagic : uint(64) = 0x005059484C474843;
+param chglHypergraphHeaderBytes = 40;
+
+// Reads the header of a binary CSR file and returns (|V|, |E|, headerOffset,
+// idBytes), where headerOffset is the byte offset of the vertex offsets and
+// idBytes the width of the IDs in the adjacency lists. Files with the
+// self-describing header are detected by their magic number and checked
+// against the size the header implies; any other file is read as |V| |E|,
+// or as |V| alone if numEdgesPresent is false.
+proc readBinHeader(dataset : string) throws {
+  var f = open(dataset, iomode.r, style = new iostyle(binary=1));
+  var reader = f.reader();
+  var numVertices : uint(64);
+  var numEdges : uint(64);
+  var headerOffset : int;
+  var idBytes = 8;
+  var magic : uint(64);
+  reader.read(magic);
+  if magic == chglCsrMagic {
+    var version, codec, width, reserved : uint(32);
+    var payloadBytes : uint(64);
+    reader.read(version, codec, numVertices, numEdges, payloadBytes);
+    if version == 1 {
+      headerOffset = 40;
+    } else if version == 2 {
+      reader.read(width, reserved);
+      idBytes = width : int;
+      headerOffset = 48;
+    } else {
+      halt(dataset, " has unsupported CSR file version ", version);
+    }
+    if codec != 0 then halt(dataset, " is compressed; only uncompressed CSR files can be read");
+    if idBytes != 4 && idBytes != 8 then halt(dataset, " has unsupported ID width ", idBytes);
+    const expectedSize = headerOffset : uint(64) + (numVertices + 1) * 8 + payloadBytes;
+    if f.length() : uint(64) != expectedSize {
+      halt(dataset, " is ", f.length(), " bytes but its header implies ", expectedSize);
+    }
+  } else {
+    numVertices = magic;
+    if numEdgesPresent then reader.read(numEdges);
+    headerOffset = if numEdgesPresent then 16 else 8;
+  }
+  reader.close();
+  f.close();
+  return (numVertices, numEdges, headerOffset, idBytes);
+}
+
+// Reads ids.size adjacency IDs that are idBytes wide into ids.
+proc readIds(reader, ref ids : [] ?t, idBytes : int) throws {
+  if idBytes == 8 {
+    reader.readBytes(c_ptrTo(ids[ids.domain.low]), (ids.size * 8) : ssize_t);
+  } else {
+    var narrow : [ids.domain] uint(32);
+    reader.readBytes(c_ptrTo(narrow[narrow.domain.low]), (ids.size * 4) : ssize_t);
+    ids = narrow : t;
+  }
+}
+
+// Whether dataset starts with the magic number of hypergraph files.
+proc isHypergraphFile(dataset : string) throws {
+  var f = open(dataset, iomode.r, style = new iostyle(binary=1));
+  var reader = f.reader();
+  var magic : uint(64);
+  reader.read(magic);
+  reader.close();
+  f.close();
+  return magic == chglHypergraphMagic;
+}
+
+// Copies the rows of the indices in dom, which are local, from one side of a
+// hypergraph file into the incidence lists of the vertices (or hyperedges).
+// The rows are sorted and free of duplicates already.
+proc readIncidenceRows(graph, f, dom, offsetsPos : int, rowsPos : int, idBytes : int, param ofVertices : bool) throws {
+  coforall chunk in chunks(dom.low..dom.high by dom.stride, here.maxTaskPar) {
+    var reader = f.reader(locking=false);
+    for idx in chunk {
+      reader.mark();
+      reader.advance(offsetsPos + idx * 8);
+      var beginOffset : uint(64);
+      var endOffset : uint(64);
+      reader.read(beginOffset);
+      reader.read(endOffset);
+      reader.revert();
+
+      const degree = (endOffset - beginOffset) : int;
+      if degree == 0 then continue;
+      reader.mark();
+      reader.advance(rowsPos + (beginOffset * idBytes:uint) : int);
+      var ids : [0..#degree] int;
+      readIds(reader, ids, idBytes);
+      reader.revert();
+
+      var node = if ofVertices then graph.getVertex(idx) else graph.getEdge(idx);
+      node.preallocate(degree);
+      node.incident[0..#degree] = ids;
+      node.size.write(degree);
+      node.isSorted = true;
+    }
+  }
+}
+
+// Reads a hypergraph file. Every locale copies the rows of the vertices and
+// hyperedges it owns from their own sections, so no inclusion is sent to
+// another locale and no duplicates need removing.
+proc binToHypergraphBothSides(dataset : string) throws {
+  var f = open(dataset, iomode.r, style = new iostyle(binary=1));
+  var reader = f.reader();
+  var magic, numVertices, numEdges, numInclusions : uint(64);
+  var version, width : uint(32);
+  reader.read(magic, version, width, numVertices, numEdges, numInclusions);
+  reader.close();
+  if version != 1 then halt(dataset, " has unsupported hypergraph file version ", version);
+  const idBytes = width : int;
+  if idBytes != 4 && idBytes != 8 then halt(dataset, " has unsupported ID width ", idBytes);
+  const vertexOffsetsPos = chglHypergraphHeaderBytes;
+  const edgeOffsetsPos = vertexOffsetsPos + ((numVertices + 1) * 8) : int;
+  const vertexRowsPos = edgeOffsetsPos + ((numEdges + 1) * 8) : int;
+  const edgeRowsPos = vertexRowsPos + (numInclusions * idBytes:uint) : int;
+  const expectedSize = edgeRowsPos + (numInclusions * idBytes:uint) : int;
+  if f.length() != expectedSize {
+    halt(dataset, " is ", f.length(), " bytes but its header implies ", expectedSize);
+  }
+  f.close();
+  debug("|V| = " + numVertices);
+  debug("|E| = " + numEdges);
+
+  var graph = new AdjListHyperGraph(numVertices:int, numEdges:int, new Cyclic(startIdx=0));
+  coforall loc in Locales do on loc {
     var f = open(dataset, iomode.r, style = new iostyle(binary=1));
-    var reader = f.reader();
+    readIncidenceRows(graph, f, graph.verticesDomain.localSubdomain(), vertexOffsetsPos, vertexRowsPos, idBytes, true);
+    readIncidenceRows(graph, f, graph.edgesDomain.localSubdomain(), edgeOffsetsPos, edgeRowsPos, idBytes, false);
+  }
+  return graph;
+}
 
+// Reads a binary file into a graph. Hypergraph files (both incidence
+// directions) are copied side by side; CSR files hold the vertex side only,
+// and the hyperedge side is built from it through aggregation buffers.
+proc binToHypergraph(dataset : string) throws {
+  try! {
+    if isHypergraphFile(dataset) then return binToHypergraphBothSides(dataset);
     // Read in |V| and |E|
-    var numVertices : uint(64);
-    var numEdges : uint(64);
-    reader.read(numVertices);
-    reader.read(numEdges);
+    var (numVertices, numEdges, headerOffset, idBytes) = readBinHeader(dataset);
     debug("|V| = " + numVertices);
     debug("|E| = " + numEdges);
-    reader.close();
-    f.close();
 
     // Construct graph (distributed)
     var graph = new AdjListHyperGraph(numVertices:int, numEdges:int, new Cyclic(startIdx=0));
@@ -41,7 +177,6 @@ proc binToHypergraph(dataset : string) throws {
         for idx in chunk {
           reader.mark();
           // Open file again and skip to portion of file we want...
-          const headerOffset = if numEdgesPresent then 16 else 8;
           reader.advance(headerOffset + idx * 8);
 
           // Read our beginning and ending offset... since the ending is the next
@@ -54,12 +189,12 @@ proc binToHypergraph(dataset : string) throws {
           endOffset -= 1;
 
           // Advance to current idx's offset...
-          var skip = ((numVertices - idx:uint - 1:uint) + beginOffset) * 8;
+          var skip = (numVertices - idx:uint - 1:uint) * 8 + beginOffset * idBytes:uint;
           reader.advance(skip:int);
 
           // Pre-allocate buffer for vector and read directly into it
           var edges : [0..#(endOffset - beginOffset + 1)] int;
-          reader.readBytes(c_ptrTo(edges[0]), ((endOffset - beginOffset + 1) * 8) : ssize_t);
+          readIds(reader, edges, idBytes);
           graph.addInclusionBuffered(idx, edges);
           reader.revert();
         }
@@ -72,18 +207,10 @@ proc binToHypergraph(dataset : string) throws {
 
 proc binToGraph(dataset : string) {
   try! {
-    var f = open(dataset, iomode.r, style = new iostyle(binary=1));
-    var reader = f.reader();
-
     // Read in |V| and |E|
-    var numVertices : uint(64);
-    var numEdges : uint(64);
-    reader.read(numVertices);
-    reader.read(numEdges);
+    var (numVertices, numEdges, headerOffset, idBytes) = readBinHeader(dataset);
     debug("|V| = " + numVertices);
     debug("|E| = " + numEdges);
-    reader.close();
-    f.close();
 
     // Construct graph (distributed)
     var graph = new Graph(numVertices:int, numEdges:int, new unmanaged Cyclic(startIdx = 0));
@@ -98,7 +225,6 @@ proc binToGraph(dataset : string) {
         for idx in chunk {
           reader.mark();
           // Open file again and skip to portion of file we want...
-          const headerOffset = 16;
           reader.advance(headerOffset + idx * 8);
 
           // Read our beginning and ending offset... since the ending is the next
@@ -111,12 +237,12 @@ proc binToGraph(dataset : string) {
           endOffset -= 1;
 
           // Advance to current idx's offset...
-          var skip = ((numVertices - idx:uint - 1:uint) + beginOffset) * 8;
+          var skip = (numVertices - idx:uint - 1:uint) * 8 + beginOffset * idBytes:uint;
           reader.advance(skip:int);
 
           // Pre-allocate buffer for vector and read directly into it
           var vertices : [0..#(endOffset - beginOffset + 1)] uint(64);
-          reader.readBytes(c_ptrTo(vertices[0]), ((endOffset - beginOffset + 1) * 8) : ssize_t);
+          readIds(reader, vertices, idBytes);
           for v in vertices do if idx < v then graph.addEdge(idx, v : int);
           reader.revert();
         }
@@ -0,0 +1,34 @@
+use CHGL;
+
+// Loads the hypergraph file of condMat, written with
+//   hypergraph-converter --edgelistfile condMat.txt --relabel none
+// and checks both incidence directions against the inclusions of
+// condMat.txt added one at a time.
+config const dataset = "../../data/condMat/condMat.txt";
+config const hypergraphFile = dataset + "_hyper.bin";
+
+var loaded = binToHypergraph(hypergraphFile);
+
+var maxVertex, maxEdge : int;
+for line in getLines(dataset) {
+  const ids = line.split();
+  maxVertex = max(maxVertex, ids[1] : int);
+  maxEdge = max(maxEdge, ids[2] : int);
+}
+var expected = new AdjListHyperGraph(maxVertex, maxEdge, new Cyclic(startIdx=0));
+for line in getLines(dataset) {
+  const ids = line.split();
+  expected.addInclusion(ids[1] : int - 1, ids[2] : int - 1);
+}
+expected.removeDuplicates();
+
+writeln("|V| = ", loaded.numVertices, ", |E| = ", loaded.numEdges);
+writeln("Inclusions: ", + reduce loaded.getVertexDegrees(), " and ", + reduce loaded.getEdgeDegrees());
+
+var verticesMatch = true, edgesMatch = true;
+for v in loaded.verticesDomain do
+  verticesMatch &&= loaded.getVertex(v).equals(expected.getVertex(v));
+for e in loaded.edgesDomain do
+  edgesMatch &&= loaded.getEdge(e).equals(expected.getEdge(e));
+writeln("Vertex rows match: ", verticesMatch);
+writeln("Hyperedge rows match: ", edgesMatch);
@@ -0,0 +1,123 @@
+/*
+ * Edge list to CSR conversion by counting sort.
+ *
+ * Degrees are counted in a first pass, turned into row offsets with a prefix
+ * sum, and both directions of every edge are scattered into one contiguous
+ * adjacency array. Rows are then sorted and deduplicated in parallel and the
+ * array is compacted in place.
+ *
+ * The incidence lists of a hypergraph are built the same way, one direction
+ * at a time: build_incidence_csr scatters every (vertex, hyperedge) pair
+ * only into the row of its vertex, or of its hyperedge when transposed.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "parallel.hpp"
+
+// Id is the type of the stored neighbor IDs; offsets are always 64-bit.
+template<typename Id>
+struct csr_graph {
+    std::vector<uint64_t> offsets;      // num_vertices + 1 entries, offsets[0] == 0
+    std::vector<Id>       adjacency;    // offsets.back() entries
+
+    uint64_t num_vertices() const { return offsets.size() - 1; }
+    uint64_t num_edges() const { return offsets.back(); }
+};
+
+// Sorts and deduplicates every row of csr in place; the unique prefix of a
+// row stays at its start and the array is then compacted. Returns the number
+// of duplicates removed.
+template<typename Id>
+size_t sort_and_unique_rows(csr_graph<Id>& csr) {
+    const uint64_t        num_rows = csr.num_vertices();
+    const uint64_t        total    = csr.num_edges();
+    std::vector<uint64_t> degree(num_rows + 1, 0);
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (uint64_t v = 0; v < num_rows; ++v) {
+        auto first = csr.adjacency.begin() + csr.offsets[v];
+        auto last  = csr.adjacency.begin() + csr.offsets[v + 1];
+        std::sort(first, last);
+        degree[v] = std::unique(first, last) - first;
+    }
+    const uint64_t unique_total = parallel_exclusive_scan(degree);
+    if (unique_total == total) return 0;
+
+    // Rows only ever move towards the front, so a forward pass is safe.
+    for (uint64_t v = 0; v < num_rows; ++v) {
+        auto first = csr.adjacency.begin() + csr.offsets[v];
+        std::copy(first, first + (degree[v + 1] - degree[v]),
+                csr.adjacency.begin() + degree[v]);
+    }
+    csr.offsets = std::move(degree);
+    csr.adjacency.resize(unique_total);
+    csr.adjacency.shrink_to_fit();
+    return total - unique_total;
+}
+
+// Builds the symmetric CSR of edges over vertices [0, num_vertices). The edge
+// list is released once it has been scattered. Returns the number of
+// duplicate adjacencies removed.
+template<typename Id>
+size_t build_symmetric_csr(std::vector<std::pair<uint64_t, uint64_t>>& edges, uint64_t num_vertices,
+        csr_graph<Id>& csr) {
+    std::vector<uint64_t> cursor(num_vertices + 1, 0);
+#pragma omp parallel for
+    for (size_t i = 0; i < edges.size(); ++i) {
+#pragma omp atomic
+        cursor[edges[i].first]++;
+#pragma omp atomic
+        cursor[edges[i].second]++;
+    }
+    const uint64_t total = parallel_exclusive_scan(cursor);
+    csr.offsets          = cursor;
+
+    csr.adjacency.resize(total);
+#pragma omp parallel for
+    for (size_t i = 0; i < edges.size(); ++i) {
+        const uint64_t src = edges[i].first, dst = edges[i].second;
+        uint64_t       pos;
+#pragma omp atomic capture
+        pos = cursor[src]++;
+        csr.adjacency[pos] = static_cast<Id>(dst);
+#pragma omp atomic capture
+        pos = cursor[dst]++;
+        csr.adjacency[pos] = static_cast<Id>(src);
+    }
+    std::vector<uint64_t>().swap(cursor);
+    std::vector<std::pair<uint64_t, uint64_t>>().swap(edges);
+    return sort_and_unique_rows(csr);
+}
+
+// Builds the CSR of pairs over rows [0, num_rows): row first of every pair
+// holds second, or the other way round if transposed. The pairs are kept.
+// Returns the number of duplicate entries removed.
+template<typename Id>
+size_t build_incidence_csr(const std::vector<std::pair<uint64_t, uint64_t>>& pairs, uint64_t num_rows,
+        bool transposed, csr_graph<Id>& csr) {
+    std::vector<uint64_t> cursor(num_rows + 1, 0);
+#pragma omp parallel for
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        const uint64_t row = transposed ? pairs[i].second : pairs[i].first;
+#pragma omp atomic
+        cursor[row]++;
+    }
+    const uint64_t total = parallel_exclusive_scan(cursor);
+    csr.offsets          = cursor;
+
+    csr.adjacency.resize(total);
+#pragma omp parallel for
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        const uint64_t row   = transposed ? pairs[i].second : pairs[i].first;
+        const uint64_t entry = transposed ? pairs[i].first : pairs[i].second;
+        uint64_t       pos;
+#pragma omp atomic capture
+        pos = cursor[row]++;
+        csr.adjacency[pos] = static_cast<Id>(entry);
+    }
+    return sort_and_unique_rows(csr);
+}
@@ -0,0 +1,272 @@
+/*
+ * Compressed codecs of the CSR binary format (see csr_format.hpp), shared by
+ * the converters (writer) and the UPC++ benchmarks (reader).
+ *
+ * Vertex offsets are the same element offsets as in the uncompressed format,
+ * so degrees can be read without decoding. Byte offsets locate each encoded
+ * row relative to the start of the encoded rows section. Every row is a
+ * sorted adjacency list stored as gaps (the first neighbor is a gap from 0):
+ *
+ *   stream_vbyte - ceil(n / 4) control bytes holding a 2-bit length code per
+ *                  gap, followed by 1-4 little-endian bytes per gap. Used when
+ *                  every gap fits in 32 bits (|V| <= 2^32); decoded with SSE4.1
+ *                  when the CPU supports it.
+ *   varint       - LEB128 varints, 7 bits per byte, for larger graphs.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSR_COMPRESSED_X86 1
+#endif
+
+#include "csr_format.hpp"
+
+/*
+ * Encoding
+ */
+
+template<typename Id, typename Alloc>
+void encode_row_varint(const Id* adj, size_t n, std::vector<uint8_t, Alloc>& out) {
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t gap = adj[i] - prev;
+        prev         = adj[i];
+        while (gap >= 0x80) {
+            out.push_back(static_cast<uint8_t>(gap) | 0x80);
+            gap >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(gap));
+    }
+}
+
+template<typename Id>
+void encode_row_stream_vbyte(const Id* adj, size_t n, std::vector<uint8_t>& out) {
+    const size_t ctrl_pos = out.size();
+    out.resize(ctrl_pos + (n + 3) / 4, 0);
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t gap = adj[i] - prev;
+        prev               = adj[i];
+        if (gap > 0xFFFFFFFFull) throw std::runtime_error("Gap does not fit stream_vbyte");
+        const unsigned len = gap < (1u << 8) ? 1 : gap < (1u << 16) ? 2 : gap < (1u << 24) ? 3 : 4;
+        out[ctrl_pos + i / 4] |= (len - 1) << (2 * (i % 4));
+        for (unsigned b = 0; b < len; ++b)
+            out.push_back(static_cast<uint8_t>(gap >> (8 * b)));
+    }
+}
+
+inline csr_codec choose_codec(uint64_t num_vertices) {
+    return num_vertices <= (uint64_t{1} << 32) ? stream_vbyte : varint;
+}
+
+template<typename Id>
+void encode_row(csr_codec codec, const Id* adj, size_t n, std::vector<uint8_t>& out) {
+    if (codec == stream_vbyte)
+        encode_row_stream_vbyte(adj, n, out);
+    else
+        encode_row_varint(adj, n, out);
+}
+
+// Streams rows, in vertex order, into a compressed CSR file. The header is
+// written by finish(), once |E| and the payload size are known.
+class compressed_csr_writer {
+public:
+    compressed_csr_writer(const std::string& path, uint64_t num_vertices, uint32_t id_bytes)
+        : payload(path, std::ofstream::binary | std::ofstream::trunc),
+          index(path, std::ofstream::binary | std::ofstream::in | std::ofstream::out) {
+        header = make_csr_file_header(choose_codec(num_vertices), num_vertices, 0, 0, id_bytes);
+        payload.seekp(csr_payload_pos(header));
+        vertex_offsets.push_back(0);
+        byte_offsets.push_back(0);
+    }
+
+    template<typename Id>
+    void add_row(const Id* adj, size_t n) {
+        buffer.clear();
+        encode_row(static_cast<csr_codec>(header.codec), adj, n, buffer);
+        payload.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+        header.num_edges += n;
+        header.payload_bytes += buffer.size();
+        vertex_offsets.push_back(header.num_edges);
+        byte_offsets.push_back(header.payload_bytes);
+        if (vertex_offsets.size() == index_batch) flush_index();
+    }
+
+    void finish() {
+        flush_index();
+        if (rows_written != header.num_vertices + 1) throw std::runtime_error("Row count does not match |V|");
+        index.seekp(0);
+        write_csr_file_header(index, header);
+        payload.flush();
+        index.flush();
+        if (!payload || !index) throw std::runtime_error("Cannot write compressed CSR file");
+    }
+
+    uint64_t payload_bytes() const { return header.payload_bytes; }
+
+private:
+    static const size_t index_batch = 1 << 16;
+
+    void flush_index() {
+        index.seekp(csr_offsets_pos(header) + rows_written * sizeof(uint64_t));
+        index.write(reinterpret_cast<const char*>(vertex_offsets.data()), vertex_offsets.size() * sizeof(uint64_t));
+        index.seekp(csr_byte_offsets_pos(header) + rows_written * sizeof(uint64_t));
+        index.write(reinterpret_cast<const char*>(byte_offsets.data()), byte_offsets.size() * sizeof(uint64_t));
+        rows_written += vertex_offsets.size();
+        vertex_offsets.clear();
+        byte_offsets.clear();
+    }
+
+    csr_file_header       header;
+    std::ofstream         payload, index;
+    std::vector<uint8_t>  buffer;
+    std::vector<uint64_t> vertex_offsets, byte_offsets;
+    uint64_t              rows_written{0};
+};
+
+/*
+ * Decoding
+ */
+
+template<typename Id>
+void decode_row_varint(const uint8_t* in, size_t n, Id* out) {
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t gap   = 0;
+        unsigned shift = 0;
+        uint8_t  byte;
+        do {
+            byte = *in++;
+            gap |= uint64_t{byte & 0x7Fu} << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        prev += gap;
+        out[i] = static_cast<Id>(prev);
+    }
+}
+
+// Decodes gaps [first, n) of a stream_vbyte row, whose data for gap `first`
+// starts at data; prev is the value of neighbor first - 1 (0 for the first).
+template<typename Id>
+void decode_stream_vbyte_scalar(const uint8_t* ctrl, const uint8_t* data, size_t first, size_t n,
+        uint64_t prev, Id* out) {
+    for (size_t i = first; i < n; ++i) {
+        const unsigned len = ((ctrl[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t       gap = 0;
+        for (unsigned b = 0; b < len; ++b)
+            gap |= uint32_t{data[b]} << (8 * b);
+        data += len;
+        prev += gap;
+        out[i] = static_cast<Id>(prev);
+    }
+}
+
+#ifdef CSR_COMPRESSED_X86
+struct stream_vbyte_tables {
+    uint8_t shuffle[256][16];
+    uint8_t length[256];
+
+    stream_vbyte_tables() {
+        for (unsigned c = 0; c < 256; ++c) {
+            unsigned src = 0;
+            for (unsigned lane = 0; lane < 4; ++lane) {
+                const unsigned len = ((c >> (2 * lane)) & 3) + 1;
+                for (unsigned b = 0; b < 4; ++b)
+                    shuffle[c][4 * lane + b] = b < len ? src + b : 0x80;
+                src += len;
+            }
+            length[c] = src;
+        }
+    }
+};
+
+inline const stream_vbyte_tables& svb_tables() {
+    static const stream_vbyte_tables tables;
+    return tables;
+}
+
+// Stores four 32-bit neighbor IDs, widening them for 64-bit IDs.
+__attribute__((target("ssse3,sse4.1"))) inline void store_ids(uint32_t* out, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), v);
+}
+__attribute__((target("ssse3,sse4.1"))) inline void store_ids(uint64_t* out, __m128i v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_cvtepu32_epi64(v));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2), _mm_cvtepu32_epi64(_mm_srli_si128(v, 8)));
+}
+
+// Four gaps per control byte: pshufb spreads them into 32-bit lanes and a
+// log-step prefix sum turns them into neighbor IDs. Only groups whose 16-byte
+// load stays inside the row are decoded here; the remainder goes through the
+// scalar loop.
+template<typename Id>
+__attribute__((target("ssse3,sse4.1"))) void decode_stream_vbyte_sse(const uint8_t* in,
+        size_t in_bytes, size_t n, Id* out) {
+    const stream_vbyte_tables& t    = svb_tables();
+    const uint8_t*             ctrl = in;
+    const uint8_t*             data = in + (n + 3) / 4;
+    const uint8_t*             end  = in + in_bytes;
+    __m128i                    prev = _mm_setzero_si128();
+    size_t                     i    = 0;
+    for (; i + 4 <= n && end - data >= 16; i += 4) {
+        const uint8_t c = ctrl[i / 4];
+        __m128i       v = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.shuffle[c])));
+        data += t.length[c];
+        v    = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        v    = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+        v    = _mm_add_epi32(v, prev);
+        prev = _mm_shuffle_epi32(v, 0xFF);
+        store_ids(out + i, v);
+    }
+    decode_stream_vbyte_scalar(ctrl, data, i, n, i > 0 ? out[i - 1] : 0, out);
+}
+
+inline bool cpu_has_sse41() {
+    static const bool has = __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3");
+    return has;
+}
+#endif
+
+template<typename Id>
+void decode_row_stream_vbyte(const uint8_t* in, size_t in_bytes, size_t n, Id* out) {
+#ifdef CSR_COMPRESSED_X86
+    if (cpu_has_sse41()) {
+        decode_stream_vbyte_sse(in, in_bytes, n, out);
+        return;
+    }
+#endif
+    decode_stream_vbyte_scalar(in, in + (n + 3) / 4, 0, n, 0, out);
+}
+
+// Decodes a row of n neighbors stored in in_bytes bytes.
+template<typename Id>
+void decode_row(uint32_t codec, const uint8_t* in, size_t in_bytes, size_t n, Id* out) {
+    if (codec == stream_vbyte)
+        decode_row_stream_vbyte(in, in_bytes, n, out);
+    else
+        decode_row_varint(in, n, out);
+}
+
+// Reads the encoded adjacency list of vertex v from a compressed CSR file
+// into bytes and returns the vertex degree; decode it with decode_row.
+inline uint64_t read_compressed_row(std::istream& in, const csr_file_header& h, uint64_t v,
+        std::vector<uint8_t>& bytes) {
+    uint64_t offsets[2], byte_offsets[2];
+    in.seekg(csr_offsets_pos(h) + v * sizeof(uint64_t));
+    in.read(reinterpret_cast<char*>(offsets), sizeof(offsets));
+    in.seekg(csr_byte_offsets_pos(h) + v * sizeof(uint64_t));
+    in.read(reinterpret_cast<char*>(byte_offsets), sizeof(byte_offsets));
+    bytes.resize(byte_offsets[1] - byte_offsets[0]);
+    in.seekg(csr_payload_pos(h) + byte_offsets[0]);
+    in.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    return offsets[1] - offsets[0];
+}
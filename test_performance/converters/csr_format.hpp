@@ -0,0 +1,245 @@
+/*
+ * Self-describing CSR binary format, shared by the converters (writers), the
+ * UPC++ benchmarks and BinReader.chpl (readers).
+ *
+ * Every file starts with a csr_file_header:
+ *
+ *   magic "CHGLCSR\0"  - 8 bytes;  Offset 0
+ *   version            - 4 bytes;  Offset 8
+ *   codec              - 4 bytes;  Offset 12
+ *   |V|                - 8 bytes;  Offset 16
+ *   |E|                - 8 bytes;  Offset 24  (adjacency entries)
+ *   payload bytes      - 8 bytes;  Offset 32
+ *   ID width in bytes  - 4 bytes;  Offset 40  (version 2 and later)
+ *   reserved           - 4 bytes;  Offset 44  (version 2 and later)
+ *
+ * Version 1 headers end after the payload size (40 bytes) and always use
+ * 8-byte IDs; they were only written for compressed files. Version 2 writers
+ * use 4-byte IDs whenever every vertex ID fits (|V| <= 2^32).
+ *
+ * codec uncompressed:
+ *   Vertex offsets  - (|V| + 1) * 8 bytes;  Offset header
+ *   Adjacency list  - |E| * ID width bytes; Offset header + (|V| + 1) * 8
+ *
+ * codec stream_vbyte / varint (see csr_compressed.hpp):
+ *   Vertex offsets  - (|V| + 1) * 8 bytes;  Offset header
+ *   Byte offsets    - (|V| + 1) * 8 bytes;  Offset header + (|V| + 1) * 8
+ *   Encoded rows    - payload bytes;        Offset header + 2 * (|V| + 1) * 8
+ *
+ * The total file size follows from the header alone, so readers validate a
+ * file with a single size check.
+ *
+ * Hypergraph files (hypergraph-converter) hold both directions of the
+ * incidence between vertices and hyperedges, every row sorted and free of
+ * duplicates, behind a hypergraph_file_header:
+ *
+ *   magic "CHGLHYP\0"  - 8 bytes;  Offset 0
+ *   version            - 4 bytes;  Offset 8
+ *   ID width in bytes  - 4 bytes;  Offset 12
+ *   |V|                - 8 bytes;  Offset 16
+ *   |E|                - 8 bytes;  Offset 24  (hyperedges)
+ *   inclusions         - 8 bytes;  Offset 32  (vertex-hyperedge pairs, I)
+ *
+ *   Vertex offsets     - (|V| + 1) * 8 bytes;  Offset 40
+ *   Hyperedge offsets  - (|E| + 1) * 8 bytes;  Offset 40 + (|V| + 1) * 8
+ *   Vertex rows        - I * ID width bytes;   hyperedges of every vertex
+ *   Hyperedge rows     - I * ID width bytes;   vertices of every hyperedge
+ *
+ * IDs are 4 bytes wide whenever both |V| and |E| allow it.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+const char     csr_file_magic[8] = {'C', 'H', 'G', 'L', 'C', 'S', 'R', '\0'};
+const uint32_t csr_file_version  = 2;
+
+enum csr_codec : uint32_t { uncompressed = 0, stream_vbyte = 1, varint = 2 };
+
+struct csr_file_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t codec;
+    uint64_t num_vertices;
+    uint64_t num_edges;
+    uint64_t payload_bytes;
+    uint32_t id_bytes;
+    uint32_t reserved;
+};
+static_assert(sizeof(csr_file_header) == 48, "csr_file_header must be packed");
+
+// Size of the version 1 header, which lacks id_bytes and reserved.
+const uint64_t csr_file_header_v1_bytes = 40;
+
+inline bool is_chgl_csr(const char* first_bytes) {
+    return std::memcmp(first_bytes, csr_file_magic, sizeof(csr_file_magic)) == 0;
+}
+
+// Width of the vertex IDs of a graph with num_vertices vertices: 4 bytes
+// whenever every ID fits in 32 bits.
+inline uint32_t csr_id_bytes(uint64_t num_vertices) {
+    return num_vertices <= (uint64_t{1} << 32) ? sizeof(uint32_t) : sizeof(uint64_t);
+}
+
+// Parses an ID width option ("auto", "32" or "64") into bytes for a graph
+// with num_vertices vertices.
+inline uint32_t parse_id_bytes(const std::string& width, uint64_t num_vertices) {
+    if (width == "auto") return csr_id_bytes(num_vertices);
+    if (width == "64") return sizeof(uint64_t);
+    if (width != "32") throw std::runtime_error("Unknown ID width: " + width);
+    if (csr_id_bytes(num_vertices) != sizeof(uint32_t)) {
+        throw std::runtime_error("32-bit IDs cannot hold " + std::to_string(num_vertices) + " vertices");
+    }
+    return sizeof(uint32_t);
+}
+
+inline csr_file_header make_csr_file_header(csr_codec codec, uint64_t num_vertices, uint64_t num_edges,
+        uint64_t payload_bytes, uint32_t id_bytes) {
+    csr_file_header h;
+    std::memcpy(h.magic, csr_file_magic, sizeof(h.magic));
+    h.version       = csr_file_version;
+    h.codec         = codec;
+    h.num_vertices  = num_vertices;
+    h.num_edges     = num_edges;
+    h.payload_bytes = payload_bytes;
+    h.id_bytes      = id_bytes;
+    h.reserved      = 0;
+    return h;
+}
+
+inline uint64_t csr_header_bytes(const csr_file_header& h) {
+    return h.version == 1 ? csr_file_header_v1_bytes : sizeof(csr_file_header);
+}
+inline uint64_t csr_offsets_pos(const csr_file_header& h) { return csr_header_bytes(h); }
+inline uint64_t csr_byte_offsets_pos(const csr_file_header& h) {
+    return csr_header_bytes(h) + (h.num_vertices + 1) * sizeof(uint64_t);
+}
+inline uint64_t csr_payload_pos(const csr_file_header& h) {
+    const uint64_t index_arrays = h.codec == uncompressed ? 1 : 2;
+    return csr_header_bytes(h) + index_arrays * (h.num_vertices + 1) * sizeof(uint64_t);
+}
+inline uint64_t csr_file_bytes(const csr_file_header& h) { return csr_payload_pos(h) + h.payload_bytes; }
+
+// Checks the fields of a header whose magic has already been matched.
+inline void validate_csr_file_header(const csr_file_header& h) {
+    if (h.version < 1 || h.version > csr_file_version) {
+        throw std::runtime_error("Unsupported CSR file version " + std::to_string(h.version));
+    }
+    if (h.codec != uncompressed && h.codec != stream_vbyte && h.codec != varint) {
+        throw std::runtime_error("Unknown CSR codec " + std::to_string(h.codec));
+    }
+    if (h.id_bytes != sizeof(uint32_t) && h.id_bytes != sizeof(uint64_t)) {
+        throw std::runtime_error("Unsupported CSR ID width " + std::to_string(h.id_bytes));
+    }
+    if (h.id_bytes < csr_id_bytes(h.num_vertices)) {
+        throw std::runtime_error("CSR ID width is too small for |V|");
+    }
+    if (h.codec == uncompressed && h.payload_bytes != h.num_edges * h.id_bytes) {
+        throw std::runtime_error("CSR payload size does not match |E|");
+    }
+}
+
+// Parses the header at the start of a file of file_bytes bytes that begins
+// with the magic string, and checks the size the header implies.
+inline void parse_csr_file_header(const char* data, uint64_t file_bytes, csr_file_header& h) {
+    if (file_bytes < csr_file_header_v1_bytes) throw std::runtime_error("Truncated CSR header");
+    std::memcpy(&h, data, csr_file_header_v1_bytes);
+    if (h.version == 1) {
+        h.id_bytes = sizeof(uint64_t);
+        h.reserved = 0;
+    } else {
+        if (file_bytes < sizeof(h)) throw std::runtime_error("Truncated CSR header");
+        std::memcpy(&h, data, sizeof(h));
+    }
+    validate_csr_file_header(h);
+    if (csr_file_bytes(h) != file_bytes) {
+        throw std::runtime_error("CSR file is " + std::to_string(file_bytes) + " bytes, header implies " +
+                std::to_string(csr_file_bytes(h)));
+    }
+}
+
+inline void read_csr_file_header(std::istream& in, csr_file_header& h) {
+    in.read(reinterpret_cast<char*>(&h), csr_file_header_v1_bytes);
+    if (!is_chgl_csr(h.magic)) throw std::runtime_error("Not a CHGL CSR file");
+    if (h.version == 1) {
+        h.id_bytes = sizeof(uint64_t);
+        h.reserved = 0;
+    } else {
+        in.read(reinterpret_cast<char*>(&h.id_bytes), sizeof(h) - csr_file_header_v1_bytes);
+    }
+    validate_csr_file_header(h);
+}
+
+inline void write_csr_file_header(std::ostream& out, const csr_file_header& h) {
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+}
+
+const char     hypergraph_file_magic[8] = {'C', 'H', 'G', 'L', 'H', 'Y', 'P', '\0'};
+const uint32_t hypergraph_file_version  = 1;
+
+struct hypergraph_file_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t id_bytes;
+    uint64_t num_vertices;
+    uint64_t num_edges;
+    uint64_t num_inclusions;
+};
+static_assert(sizeof(hypergraph_file_header) == 40, "hypergraph_file_header must be packed");
+
+inline hypergraph_file_header make_hypergraph_file_header(uint64_t num_vertices, uint64_t num_edges,
+        uint64_t num_inclusions, uint32_t id_bytes) {
+    hypergraph_file_header h;
+    std::memcpy(h.magic, hypergraph_file_magic, sizeof(h.magic));
+    h.version        = hypergraph_file_version;
+    h.id_bytes       = id_bytes;
+    h.num_vertices   = num_vertices;
+    h.num_edges      = num_edges;
+    h.num_inclusions = num_inclusions;
+    return h;
+}
+
+inline uint64_t hypergraph_vertex_offsets_pos(const hypergraph_file_header&) {
+    return sizeof(hypergraph_file_header);
+}
+inline uint64_t hypergraph_edge_offsets_pos(const hypergraph_file_header& h) {
+    return hypergraph_vertex_offsets_pos(h) + (h.num_vertices + 1) * sizeof(uint64_t);
+}
+inline uint64_t hypergraph_vertex_rows_pos(const hypergraph_file_header& h) {
+    return hypergraph_edge_offsets_pos(h) + (h.num_edges + 1) * sizeof(uint64_t);
+}
+inline uint64_t hypergraph_edge_rows_pos(const hypergraph_file_header& h) {
+    return hypergraph_vertex_rows_pos(h) + h.num_inclusions * h.id_bytes;
+}
+inline uint64_t hypergraph_file_bytes(const hypergraph_file_header& h) {
+    return hypergraph_edge_rows_pos(h) + h.num_inclusions * h.id_bytes;
+}
+
+// Parses the header at the start of a hypergraph file of file_bytes bytes
+// and checks the size the header implies.
+inline void parse_hypergraph_file_header(const char* data, uint64_t file_bytes, hypergraph_file_header& h) {
+    if (file_bytes < sizeof(h)) throw std::runtime_error("Truncated hypergraph header");
+    std::memcpy(&h, data, sizeof(h));
+    if (std::memcmp(h.magic, hypergraph_file_magic, sizeof(h.magic)) != 0) {
+        throw std::runtime_error("Not a CHGL hypergraph file");
+    }
+    if (h.version != hypergraph_file_version) {
+        throw std::runtime_error("Unsupported hypergraph file version " + std::to_string(h.version));
+    }
+    if (h.id_bytes != sizeof(uint32_t) && h.id_bytes != sizeof(uint64_t)) {
+        throw std::runtime_error("Unsupported hypergraph ID width " + std::to_string(h.id_bytes));
+    }
+    if (hypergraph_file_bytes(h) != file_bytes) {
+        throw std::runtime_error("Hypergraph file is " + std::to_string(file_bytes) + " bytes, header implies " +
+                std::to_string(hypergraph_file_bytes(h)));
+    }
+}
+
+inline void write_hypergraph_file_header(std::ostream& out, const hypergraph_file_header& h) {
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+}
@@ -0,0 +1,208 @@
+/*
+ * External-memory sort of (src, dst) pairs.
+ *
+ * Pairs are collected in a buffer of at most half the memory budget, which
+ * leaves room for the temporary buffer of the merge steps of parallel_sort and
+ * for the copy made while the buffer grows. A full buffer is sorted,
+ * deduplicated and spilled to a temporary run file. merge() then
+ * streams every distinct pair in sorted order through a k-way merge of the
+ * runs; when there are more runs than fit in the budget they are first merged
+ * into longer runs in several passes.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "parallel.hpp"
+
+using edge_pair = std::pair<uint64_t, uint64_t>;
+
+// Parses sizes such as "512M" or "64G" into bytes.
+inline size_t parse_memory_size(const std::string& text) {
+    size_t pos   = 0;
+    size_t value = std::stoull(text, &pos);
+    if (pos < text.size()) {
+        switch (text[pos]) {
+            case 'k': case 'K': value <<= 10; break;
+            case 'm': case 'M': value <<= 20; break;
+            case 'g': case 'G': value <<= 30; break;
+            case 't': case 'T': value <<= 40; break;
+            default: throw std::runtime_error("Bad memory size: " + text);
+        }
+    }
+    return value;
+}
+
+// Buffered binary output of fixed-size records.
+template<typename T>
+class record_writer {
+public:
+    record_writer(std::ofstream& out, size_t capacity) : out(out) { buffer.reserve(capacity); }
+    ~record_writer() { flush(); }
+
+    void put(const T& value) {
+        buffer.push_back(value);
+        if (buffer.size() == buffer.capacity()) flush();
+    }
+    void flush() {
+        out.write(reinterpret_cast<const char*>(buffer.data()), sizeof(T) * buffer.size());
+        buffer.clear();
+    }
+
+private:
+    std::ofstream& out;
+    std::vector<T> buffer;
+};
+
+// Buffered sequential reader over one sorted run file.
+class run_reader {
+public:
+    run_reader(const std::string& path, size_t capacity)
+        : in(path, std::ifstream::binary), buffer(capacity) {
+        if (!in) throw std::runtime_error("Cannot open run " + path);
+        refill();
+    }
+
+    bool             empty() const { return pos == size; }
+    const edge_pair& top() const { return buffer[pos]; }
+    void             pop() {
+        if (++pos == size) refill();
+    }
+
+private:
+    void refill() {
+        in.read(reinterpret_cast<char*>(buffer.data()), sizeof(edge_pair) * buffer.size());
+        size = in.gcount() / sizeof(edge_pair);
+        pos  = 0;
+    }
+
+    std::ifstream          in;
+    std::vector<edge_pair> buffer;
+    size_t                 pos{0}, size{0};
+};
+
+// Smallest read buffer, in pairs, given to each run during a merge.
+const size_t min_run_buffer = size_t{1} << 16;
+
+class external_edge_sorter {
+public:
+    // expected_pairs only sizes the in-memory buffer up front; the buffer
+    // never grows beyond run_capacity.
+    external_edge_sorter(size_t memory_budget, std::string tmp_prefix, size_t expected_pairs)
+        : budget(std::max(memory_budget, 4 * min_run_buffer * sizeof(edge_pair))),
+          run_capacity(budget / 2 / sizeof(edge_pair)), prefix(std::move(tmp_prefix)) {
+        buffer.reserve(std::min(run_capacity, expected_pairs));
+    }
+    ~external_edge_sorter() {
+        for (const auto& run : runs) std::remove(run.c_str());
+    }
+    external_edge_sorter(const external_edge_sorter&) = delete;
+    external_edge_sorter& operator=(const external_edge_sorter&) = delete;
+
+    void push(uint64_t src, uint64_t dst) {
+        if (buffer.size() == buffer.capacity()) {
+            if (buffer.size() < run_capacity) {
+                buffer.reserve(std::min(run_capacity, 2 * buffer.size() + 1));
+            } else {
+                spill();
+            }
+        }
+        buffer.emplace_back(src, dst);
+    }
+
+    size_t num_runs() const { return runs.size(); }
+
+    // Calls emit(src, dst) once for every distinct pair, in sorted order.
+    template<typename F>
+    void merge(F emit) {
+        if (runs.empty()) {
+            sort_buffer();
+            for (const auto& e : buffer) emit(e.first, e.second);
+            std::vector<edge_pair>().swap(buffer);
+            return;
+        }
+        if (!buffer.empty()) spill();
+        std::vector<edge_pair>().swap(buffer);
+
+        const size_t fan_in = std::max<size_t>(2, budget / sizeof(edge_pair) / min_run_buffer - 1);
+        while (runs.size() > fan_in) {
+            std::vector<std::string> next;
+            for (size_t first = 0; first < runs.size(); first += fan_in) {
+                std::vector<std::string> group(runs.begin() + first,
+                        runs.begin() + std::min(first + fan_in, runs.size()));
+                const std::string path = new_run_path();
+                {
+                    std::ofstream             out(path, std::ofstream::binary);
+                    record_writer<edge_pair> writer(out, min_run_buffer);
+                    merge_runs(group, [&](uint64_t src, uint64_t dst) { writer.put(edge_pair(src, dst)); });
+                }
+                for (const auto& run : group) std::remove(run.c_str());
+                next.push_back(path);
+            }
+            runs.swap(next);
+        }
+        merge_runs(runs, emit);
+        for (const auto& run : runs) std::remove(run.c_str());
+        runs.clear();
+    }
+
+private:
+    void sort_buffer() {
+        parallel_sort(buffer.begin(), buffer.end());
+        buffer.erase(std::unique(buffer.begin(), buffer.end()), buffer.end());
+    }
+
+    std::string new_run_path() { return prefix + ".run" + std::to_string(next_run++); }
+
+    void spill() {
+        sort_buffer();
+        const std::string path = new_run_path();
+        std::ofstream     out(path, std::ofstream::binary);
+        out.write(reinterpret_cast<const char*>(buffer.data()), sizeof(edge_pair) * buffer.size());
+        if (!out) throw std::runtime_error("Cannot write run " + path);
+        runs.push_back(path);
+        buffer.clear();
+    }
+
+    template<typename F>
+    void merge_runs(const std::vector<std::string>& paths, F emit) {
+        const size_t per_run = std::max(min_run_buffer, budget / sizeof(edge_pair) / (paths.size() + 1));
+        std::vector<std::unique_ptr<run_reader>> readers;
+        using entry = std::pair<edge_pair, size_t>;
+        std::priority_queue<entry, std::vector<entry>, std::greater<entry>> heap;
+        for (const auto& path : paths) {
+            readers.emplace_back(new run_reader(path, per_run));
+            if (!readers.back()->empty()) heap.emplace(readers.back()->top(), readers.size() - 1);
+        }
+
+        bool      first = true;
+        edge_pair last;
+        while (!heap.empty()) {
+            const entry e = heap.top();
+            heap.pop();
+            if (first || e.first != last) emit(e.first.first, e.first.second);
+            first = false;
+            last  = e.first;
+            run_reader& reader = *readers[e.second];
+            reader.pop();
+            if (!reader.empty()) heap.emplace(reader.top(), e.second);
+        }
+    }
+
+    size_t                   budget;
+    size_t                   run_capacity;    // pairs held before a spill
+    std::string              prefix;
+    std::vector<edge_pair>   buffer;
+    std::vector<std::string> runs;
+    size_t                   next_run{0};
+};
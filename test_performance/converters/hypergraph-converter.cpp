@@ -0,0 +1,100 @@
+// Converts a bipartite (vertex, hyperedge) incidence list into a hypergraph
+// file that holds both incidence directions (see csr_format.hpp), so that
+// loaders copy each side as is instead of rebuilding one from the other.
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <string>
+
+#include "csr_builder.hpp"
+#include "csr_format.hpp"
+#include "mtx_reader.hpp"
+#include "relabel.hpp"
+
+typedef uint64_t IndexType;
+std::string edgelistFile = "";
+std::string relabelMode = "first-seen";
+std::string idWidth = "auto";
+
+// Builds both directions with Id-wide IDs and writes them.
+template<typename Id>
+void write_hypergraph(std::vector<mtx_edge>& inclusions, IndexType num_vertices, IndexType num_edges) {
+    csr_graph<Id> vertex_rows, edge_rows;
+    size_t removed_count = build_incidence_csr(inclusions, num_vertices, false, vertex_rows);
+    build_incidence_csr(inclusions, num_edges, true, edge_rows);
+    std::vector<mtx_edge>().swap(inclusions);
+    const IndexType num_inclusions = vertex_rows.num_edges();
+
+    std::cout << "Removed " << removed_count << " duplicate inclusions" << std::endl;
+    std::cout << "Inclusions: " << num_inclusions << "\n";
+
+    // Binary output data format:
+    // hypergraph_file_header (40bytes, see csr_format.hpp)
+    // Vertex_offsets [(Num_vertices + 1)*8bytes] (first element 0)
+    // Edge_offsets [(Num_edges + 1)*8bytes] (first element 0)
+    // vertex_rows [Num_inclusions*sizeof(Id)bytes] ...
+    // edge_rows [Num_inclusions*sizeof(Id)bytes] ...
+    std::string opath = edgelistFile + "_hyper.bin";
+
+    std::ofstream outfile(opath, std::ofstream::binary);
+    write_hypergraph_file_header(outfile, make_hypergraph_file_header(num_vertices, num_edges,
+            num_inclusions, sizeof(Id)));
+    outfile.write(reinterpret_cast<char*>(vertex_rows.offsets.data()), sizeof(IndexType)*vertex_rows.offsets.size());
+    outfile.write(reinterpret_cast<char*>(edge_rows.offsets.data()), sizeof(IndexType)*edge_rows.offsets.size());
+    outfile.write(reinterpret_cast<char*>(vertex_rows.adjacency.data()), sizeof(Id)*vertex_rows.adjacency.size());
+    outfile.write(reinterpret_cast<char*>(edge_rows.adjacency.data()), sizeof(Id)*edge_rows.adjacency.size());
+    std::cout << "Wrote " << opath << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int argIndex = 1;
+
+    while (argIndex < argc) {
+        std::string arg(argv[argIndex]);
+        if (arg == "--edgelistfile") {
+            ++argIndex;
+            edgelistFile = std::string(argv[argIndex]);
+            ++argIndex;
+        } else if (arg == "--relabel") {
+            ++argIndex;
+            relabelMode = std::string(argv[argIndex]);
+            ++argIndex;
+        } else if (arg == "--id-width") {
+            ++argIndex;
+            idWidth = std::string(argv[argIndex]);
+            ++argIndex;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // A MatrixMarket file has a row per vertex and a column per hyperedge;
+    // anything else is read as one "vertex hyperedge" pair per line.
+    std::vector<mtx_edge> inclusions;
+    if (is_mtx_file(edgelistFile)) {
+        mtx_header mtx;
+        read_mtx_mmap(edgelistFile, mtx, inclusions);
+    } else {
+        read_pair_list_mmap(edgelistFile, inclusions);
+    }
+    IndexType num_links = inclusions.size();
+    if (num_links == 0) { std::cerr << "No inclusions read from the file" << std::endl; abort(); }
+
+    const auto sizes = relabel_bipartite(inclusions, parse_relabel_mode(relabelMode));
+    const IndexType num_vertices = sizes.first, num_edges = sizes.second;
+
+    std::cout << "Read " << num_links << " links.\n";
+    std::cout << "Num vertices: " << num_vertices << "\n";
+    std::cout << "Num hyperedges: " << num_edges << "\n";
+
+    const uint32_t id_bytes = parse_id_bytes(idWidth, std::max(num_vertices, num_edges));
+    std::cout << "ID width: " << 8 * id_bytes << " bits\n";
+    if (id_bytes == sizeof(uint32_t))
+        write_hypergraph<uint32_t>(inclusions, num_vertices, num_edges);
+    else
+        write_hypergraph<uint64_t>(inclusions, num_vertices, num_edges);
+}
@@ -0,0 +1,52 @@
+/*
+ * Read-only memory mapping of a whole file, shared by the converters and the
+ * UPC++ benchmark loader.
+ */
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only mapping of a whole file, unmapped on destruction.
+class mapped_file {
+public:
+    explicit mapped_file(const std::string& path, int advice = MADV_SEQUENTIAL) {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat " + path);
+        }
+        length = st.st_size;
+        if (length > 0) {
+            addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Cannot mmap " + path);
+            }
+            ::madvise(addr, length, advice);
+        }
+    }
+    ~mapped_file() {
+        if (addr != nullptr && addr != MAP_FAILED) ::munmap(addr, length);
+        if (fd >= 0) ::close(fd);
+    }
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    const char* begin() const { return static_cast<const char*>(addr); }
+    const char* end() const { return begin() + length; }
+    size_t      size() const { return length; }
+
+private:
+    int    fd{-1};
+    void*  addr{nullptr};
+    size_t length{0};
+};
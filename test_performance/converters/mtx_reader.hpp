@@ -0,0 +1,240 @@
+/*
+ * Parallel MatrixMarket (coordinate) ingest.
+ *
+ * The file is memory-mapped, the nonzero section is split into
+ * newline-aligned chunks and every chunk is parsed independently with a
+ * hand-rolled integer parser. Chunks are concatenated in file order, so the
+ * resulting edge list is identical to reading the file line by line.
+ * Headerless lists of pairs (one "a b" or "a,b" per line) are parsed the
+ * same way.
+ *
+ * Compile with -fopenmp to parse chunks on all cores; without it the same
+ * code runs on a single thread.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "mapped_file.hpp"
+
+struct mtx_header {
+    bool     symmetric{false};
+    uint64_t n0{0}, n1{0}, nNonzeros{0};
+};
+
+using mtx_edge = std::pair<uint64_t, uint64_t>;
+
+// Returns the position just past the next '\n' at or after p (or end).
+inline const char* next_line(const char* p, const char* end) {
+    const void* nl = std::memchr(p, '\n', end - p);
+    return nl ? static_cast<const char*>(nl) + 1 : end;
+}
+
+// Parses an unsigned decimal integer, skipping leading blanks and commas.
+// Returns nullptr if no digits are found before the end of the line.
+inline const char* parse_uint(const char* p, const char* end, uint64_t& value) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) ++p;
+    if (p == end || *p < '0' || *p > '9') return nullptr;
+    uint64_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p - '0');
+        ++p;
+    }
+    value = v;
+    return p;
+}
+
+// Parses the "src dst [value]" lines in [p, end); comment and blank lines
+// are skipped.
+inline void parse_mtx_chunk(const char* p, const char* end,
+        std::vector<mtx_edge>& edges) {
+    while (p < end) {
+        const char* eol = next_line(p, end);
+        uint64_t    src, dst;
+        if (*p != '%') {
+            const char* q = parse_uint(p, eol, src);
+            if (q && parse_uint(q, eol, dst)) edges.emplace_back(src, dst);
+        }
+        p = eol;
+    }
+}
+
+// Parses the "%%MatrixMarket matrix coordinate <field> <symmetry>" banner.
+inline void parse_mtx_banner(const std::string& line, mtx_header& hdr) {
+    std::vector<std::string> header(5);
+    std::stringstream h(line);
+    for (auto& s : header)
+        h >> s;
+
+    if (header[0] != "%%MatrixMarket") {
+        throw std::runtime_error("Unsupported format");
+    }
+    if (header[4] == "symmetric") {
+        hdr.symmetric = true;
+    } else if (header[4] == "general") {
+        hdr.symmetric = false;
+    } else {
+        throw std::runtime_error("Bad format (symmetry): " + header[4]);
+    }
+}
+
+// Parses the banner and size line; returns the start of the nonzero section.
+inline const char* parse_mtx_header(const char* p, const char* end,
+        mtx_header& hdr) {
+    const char* eol = next_line(p, end);
+    parse_mtx_banner(std::string(p, eol), hdr);
+
+    p = eol;
+    while (p < end && *p == '%') p = next_line(p, end);
+    eol = next_line(p, end);
+    std::stringstream(std::string(p, eol)) >> hdr.n0 >> hdr.n1 >> hdr.nNonzeros;
+    return eol;
+}
+
+// Parses every (src, dst) line in [body, end) into edges, in file order,
+// using all available threads.
+inline void parse_pairs_parallel(const char* body, const char* end,
+        std::vector<mtx_edge>& edges) {
+    int nthreads = 1;
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads();
+#endif
+    // A few chunks per thread to even out lines of different lengths.
+    size_t nchunks = 4 * static_cast<size_t>(nthreads);
+    size_t span    = end - body;
+    if (span < (1 << 20)) nchunks = 1;
+
+    std::vector<const char*> bounds(nchunks + 1);
+    bounds[0]       = body;
+    bounds[nchunks] = end;
+    for (size_t c = 1; c < nchunks; ++c) {
+        const char* guess = body + span / nchunks * c;
+        bounds[c] = std::max(bounds[c - 1], next_line(guess, end));
+    }
+
+    std::vector<std::vector<mtx_edge>> parts(nchunks);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t c = 0; c < nchunks; ++c) {
+        parts[c].reserve((bounds[c + 1] - bounds[c]) / 8);
+        parse_mtx_chunk(bounds[c], bounds[c + 1], parts[c]);
+    }
+
+    std::vector<size_t> starts(nchunks + 1, 0);
+    for (size_t c = 0; c < nchunks; ++c)
+        starts[c + 1] = starts[c] + parts[c].size();
+
+    edges.resize(starts[nchunks]);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t c = 0; c < nchunks; ++c) {
+        std::copy(parts[c].begin(), parts[c].end(), edges.begin() + starts[c]);
+        std::vector<mtx_edge>().swap(parts[c]);
+    }
+}
+
+// Reads the first nNonzeros (src, dst) pairs of a MatrixMarket file, in file
+// order, using all available threads.
+inline void read_mtx_mmap(const std::string& filename, mtx_header& hdr,
+        std::vector<mtx_edge>& edges) {
+    mapped_file file(filename);
+    const char* body = parse_mtx_header(file.begin(), file.end(), hdr);
+    parse_pairs_parallel(body, file.end(), edges);
+    if (edges.size() < hdr.nNonzeros) {
+        throw std::runtime_error("Expected " + std::to_string(hdr.nNonzeros) +
+                " nonzeros, found " + std::to_string(edges.size()));
+    }
+    edges.resize(hdr.nNonzeros);
+}
+
+// Whether the file starts with a MatrixMarket banner.
+inline bool is_mtx_file(const std::string& filename) {
+    std::ifstream in(filename);
+    std::string   banner;
+    in >> banner;
+    return banner == "%%MatrixMarket";
+}
+
+// Reads every (src, dst) pair of a headerless list, one pair per line
+// separated by blanks or a comma, in file order. Lines that do not start
+// with two integers (comments, CSV headers) are skipped.
+inline void read_pair_list_mmap(const std::string& filename,
+        std::vector<mtx_edge>& edges) {
+    mapped_file file(filename);
+    parse_pairs_parallel(file.begin(), file.end(), edges);
+}
+
+// Sequential pass over the nonzeros of a memory-mapped MatrixMarket file
+// that never materializes the edge list.
+class mtx_edge_stream {
+public:
+    explicit mtx_edge_stream(const std::string& filename) : file(filename) {
+        body = parse_mtx_header(file.begin(), file.end(), hdr);
+    }
+
+    const mtx_header& header() const { return hdr; }
+
+    // Calls f(src, dst) for each of the first nNonzeros entries, in file order.
+    template<typename F>
+    void for_each(F f) const {
+        const char* p   = body;
+        const char* end = file.end();
+        uint64_t    seen = 0;
+        while (p < end && seen < hdr.nNonzeros) {
+            const char* eol = next_line(p, end);
+            uint64_t    src, dst;
+            if (*p != '%') {
+                const char* q = parse_uint(p, eol, src);
+                if (q && parse_uint(q, eol, dst)) {
+                    f(src, dst);
+                    ++seen;
+                }
+            }
+            p = eol;
+        }
+        if (seen < hdr.nNonzeros) {
+            throw std::runtime_error("Expected " + std::to_string(hdr.nNonzeros) +
+                    " nonzeros, found " + std::to_string(seen));
+        }
+    }
+
+private:
+    mapped_file file;
+    mtx_header  hdr;
+    const char* body;
+};
+
+// Line-by-line reference reader, kept for comparison with read_mtx_mmap.
+inline void read_mtx_stream(const std::string& filename, mtx_header& hdr,
+        std::vector<mtx_edge>& edges) {
+    std::string   string_input;
+    std::ifstream inputFile(filename);
+    std::getline(inputFile, string_input);
+    parse_mtx_banner(string_input, hdr);
+
+    while (std::getline(inputFile, string_input)) {
+        if (string_input[0] != '%') break;
+    }
+    std::stringstream(string_input) >> hdr.n0 >> hdr.n1 >> hdr.nNonzeros;
+
+    edges.reserve(hdr.nNonzeros);
+    for (size_t i = 0; i < hdr.nNonzeros; ++i) {
+        std::string buffer;
+        uint64_t    src, dst;
+
+        std::getline(inputFile, buffer);
+        std::stringstream(buffer) >> src >> dst;
+        edges.emplace_back(src, dst);
+    }
+}
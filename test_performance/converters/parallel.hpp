@@ -0,0 +1,86 @@
+/*
+ * Small OpenMP helpers shared by the converters. Without -fopenmp every
+ * helper degrades to its sequential equivalent.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+inline int max_threads() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Sorts [first, last): every thread sorts one contiguous run, then runs are
+// merged pairwise in parallel rounds.
+template<typename RandomIt, typename Compare>
+void parallel_sort(RandomIt first, RandomIt last, Compare comp) {
+    const size_t n      = last - first;
+    size_t       nparts = static_cast<size_t>(max_threads());
+    if (nparts <= 1 || n < (size_t{1} << 16)) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    std::vector<size_t> bounds(nparts + 1);
+    for (size_t p = 0; p <= nparts; ++p)
+        bounds[p] = n * p / nparts;
+
+#pragma omp parallel for schedule(static, 1)
+    for (size_t p = 0; p < nparts; ++p)
+        std::sort(first + bounds[p], first + bounds[p + 1], comp);
+
+    for (size_t width = 1; width < nparts; width *= 2) {
+#pragma omp parallel for schedule(dynamic, 1)
+        for (size_t p = 0; p < nparts - width; p += 2 * width) {
+            const size_t hi = std::min(p + 2 * width, nparts);
+            std::inplace_merge(first + bounds[p], first + bounds[p + width],
+                    first + bounds[hi], comp);
+        }
+    }
+}
+
+template<typename RandomIt>
+void parallel_sort(RandomIt first, RandomIt last) {
+    parallel_sort(first, last, std::less<typename std::iterator_traits<RandomIt>::value_type>());
+}
+
+// In-place exclusive prefix sum; returns the total.
+template<typename T>
+T parallel_exclusive_scan(std::vector<T>& values) {
+    const size_t n      = values.size();
+    const size_t nparts = std::max<size_t>(1, std::min<size_t>(max_threads(), n / 4096));
+    std::vector<T> partial(nparts + 1, 0);
+
+#pragma omp parallel for schedule(static, 1)
+    for (size_t p = 0; p < nparts; ++p) {
+        T sum = 0;
+        for (size_t i = n * p / nparts; i < n * (p + 1) / nparts; ++i)
+            sum += values[i];
+        partial[p + 1] = sum;
+    }
+    for (size_t p = 0; p < nparts; ++p)
+        partial[p + 1] += partial[p];
+
+#pragma omp parallel for schedule(static, 1)
+    for (size_t p = 0; p < nparts; ++p) {
+        T sum = partial[p];
+        for (size_t i = n * p / nparts; i < n * (p + 1) / nparts; ++i) {
+            T v       = values[i];
+            values[i] = sum;
+            sum += v;
+        }
+    }
+    return partial[nparts];
+}
@@ -0,0 +1,260 @@
+/*
+ * Vertex renumbering for the converters.
+ *
+ * first-seen: IDs are assigned in order of first appearance in the edge list
+ *             (src before dst), which is what the converters always did. Dense
+ *             ID ranges use a direct-mapped array, sparse ones an
+ *             open-addressing hash table.
+ * sorted:     IDs are assigned in increasing order of the original ID, using a
+ *             parallel sort-and-unique of all endpoints.
+ * none:       the input is already 1-based and dense; IDs are only shifted
+ *             to 0-based. Inputs whose ID range is sparse are rejected.
+ *
+ * relabel_bipartite applies a mode to the two sides of a (vertex, hyperedge)
+ * list separately, so that vertices and hyperedges get their own ID ranges.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "parallel.hpp"
+
+enum class relabel_mode { first_seen, sorted, none };
+
+inline relabel_mode parse_relabel_mode(const std::string& mode) {
+    if (mode == "first-seen") return relabel_mode::first_seen;
+    if (mode == "sorted") return relabel_mode::sorted;
+    if (mode == "none") return relabel_mode::none;
+    throw std::runtime_error("Unknown relabel mode: " + mode);
+}
+
+const uint64_t unassigned_id = std::numeric_limits<uint64_t>::max();
+
+// A direct-mapped table is used while it needs at most this many slots per
+// edge endpoint; beyond that the ID range is considered sparse.
+const uint64_t dense_slots_per_endpoint = 4;
+
+// Linear-probing hash map from original to new vertex ID.
+class vertex_id_map {
+public:
+    explicit vertex_id_map(size_t expected) {
+        size_t capacity = 16;
+        while (capacity < 2 * expected) capacity *= 2;
+        rehash(capacity);
+    }
+
+    // Returns the new ID of key, assigning next_id++ if it was not present.
+    uint64_t find_or_insert(uint64_t key, uint64_t& next_id) {
+        size_t slot = probe(key);
+        if (keys[slot] == key) return values[slot];
+        if (2 * (count + 1) > keys.size()) {
+            rehash(2 * keys.size());
+            slot = probe(key);
+        }
+        keys[slot]   = key;
+        values[slot] = next_id;
+        ++count;
+        return next_id++;
+    }
+
+    // Inserts a key that is known not to be present.
+    void insert(uint64_t key, uint64_t value) {
+        uint64_t next_id = value;
+        find_or_insert(key, next_id);
+    }
+
+    size_t bytes() const { return (keys.capacity() + values.capacity()) * sizeof(uint64_t); }
+
+private:
+    size_t probe(uint64_t key) const {
+        size_t slot = (key * 0x9E3779B97F4A7C15ull) >> shift;
+        while (keys[slot] != unassigned_id && keys[slot] != key)
+            slot = (slot + 1) & (keys.size() - 1);
+        return slot;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<uint64_t> old_keys(capacity, unassigned_id), old_values(capacity);
+        old_keys.swap(keys);
+        old_values.swap(values);
+        shift = 64;
+        for (size_t c = capacity; c > 1; c /= 2) --shift;
+        for (size_t i = 0; i < old_keys.size(); ++i) {
+            if (old_keys[i] == unassigned_id) continue;
+            size_t slot  = probe(old_keys[i]);
+            keys[slot]   = old_keys[i];
+            values[slot] = old_values[i];
+        }
+    }
+
+    std::vector<uint64_t> keys, values;
+    size_t                count{0};
+    unsigned              shift{64};
+};
+
+inline uint64_t max_endpoint(const std::vector<std::pair<uint64_t, uint64_t>>& edges) {
+    uint64_t max_id = 0;
+#pragma omp parallel for reduction(max : max_id)
+    for (size_t i = 0; i < edges.size(); ++i)
+        max_id = std::max({max_id, edges[i].first, edges[i].second});
+    return max_id;
+}
+
+inline bool is_dense_range(uint64_t max_id, size_t num_edges) {
+    return max_id / dense_slots_per_endpoint <= 2 * num_edges;
+}
+
+// Without relabeling every ID up to the largest becomes a vertex, so a sparse
+// range would blow up |V| and the offsets array; such inputs are rejected.
+inline void check_dense_ids(uint64_t max_id, size_t num_edges) {
+    if (!is_dense_range(max_id, num_edges))
+        throw std::runtime_error("Vertex IDs up to " + std::to_string(max_id) + " are too sparse for " +
+                std::to_string(num_edges) + " edges; use --relabel first-seen or sorted");
+}
+
+// Assigns IDs in order of first appearance, one endpoint at a time. Used
+// directly by the external-memory converter, which never holds the edge list.
+// The hash table starts small and grows with the vertices actually seen, so
+// it stays O(|V|) however many edges there are.
+class first_seen_relabeler {
+public:
+    first_seen_relabeler(uint64_t max_id_hint, size_t num_edges_hint)
+        : dense(is_dense_range(max_id_hint, num_edges_hint)), num_edges(num_edges_hint), table(0) {
+        if (dense) direct.assign(max_id_hint + 1, unassigned_id);
+    }
+
+    uint64_t operator()(uint64_t id) {
+        if (!dense) return table.find_or_insert(id, next_id);
+        if (id >= direct.size()) {
+            // The hint was wrong (e.g. IDs beyond the declared dimensions):
+            // grow the array while the range stays dense, else move to the
+            // hash table.
+            if (!is_dense_range(id, num_edges)) {
+                switch_to_table();
+                return table.find_or_insert(id, next_id);
+            }
+            direct.resize(id + 1, unassigned_id);
+        }
+        if (direct[id] == unassigned_id) direct[id] = next_id++;
+        return direct[id];
+    }
+
+    uint64_t num_vertices() const { return next_id; }
+
+    // Memory held by the direct-mapped array or the hash table.
+    size_t bytes() const { return dense ? direct.capacity() * sizeof(uint64_t) : table.bytes(); }
+
+private:
+    void switch_to_table() {
+        table = vertex_id_map(next_id);
+        for (uint64_t id = 0; id < direct.size(); ++id)
+            if (direct[id] != unassigned_id) table.insert(id, direct[id]);
+        std::vector<uint64_t>().swap(direct);
+        dense = false;
+    }
+
+    bool                  dense;
+    size_t                num_edges;
+    std::vector<uint64_t> direct;
+    vertex_id_map         table;
+    uint64_t              next_id{0};
+};
+
+inline uint64_t relabel_first_seen(std::vector<std::pair<uint64_t, uint64_t>>& edges) {
+    first_seen_relabeler relabel(max_endpoint(edges), edges.size());
+    for (auto& edge : edges) {
+        edge.first  = relabel(edge.first);
+        edge.second = relabel(edge.second);
+    }
+    return relabel.num_vertices();
+}
+
+inline uint64_t relabel_sorted(std::vector<std::pair<uint64_t, uint64_t>>& edges) {
+    std::vector<uint64_t> ids(2 * edges.size());
+#pragma omp parallel for
+    for (size_t i = 0; i < edges.size(); ++i) {
+        ids[2 * i]     = edges[i].first;
+        ids[2 * i + 1] = edges[i].second;
+    }
+    parallel_sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    ids.shrink_to_fit();
+
+    if (!ids.empty() && is_dense_range(ids.back(), edges.size())) {
+        std::vector<uint64_t> table(ids.back() + 1);
+#pragma omp parallel for
+        for (size_t i = 0; i < ids.size(); ++i)
+            table[ids[i]] = i;
+#pragma omp parallel for
+        for (size_t i = 0; i < edges.size(); ++i) {
+            edges[i].first  = table[edges[i].first];
+            edges[i].second = table[edges[i].second];
+        }
+    } else {
+        auto rank = [&](uint64_t v) {
+            return static_cast<uint64_t>(std::lower_bound(ids.begin(), ids.end(), v) - ids.begin());
+        };
+#pragma omp parallel for
+        for (size_t i = 0; i < edges.size(); ++i) {
+            edges[i].first  = rank(edges[i].first);
+            edges[i].second = rank(edges[i].second);
+        }
+    }
+    return ids.size();
+}
+
+inline uint64_t relabel_none(std::vector<std::pair<uint64_t, uint64_t>>& edges) {
+    bool has_zero = false;
+#pragma omp parallel for reduction(|| : has_zero)
+    for (size_t i = 0; i < edges.size(); ++i) {
+        has_zero = has_zero || edges[i].first == 0 || edges[i].second == 0;
+        edges[i].first -= 1;
+        edges[i].second -= 1;
+    }
+    if (has_zero) throw std::runtime_error("Vertex IDs are not 1-based; use --relabel first-seen or sorted");
+    if (edges.empty()) return 0;
+    const uint64_t max_id = max_endpoint(edges) + 1;
+    check_dense_ids(max_id, edges.size());
+    return max_id;
+}
+
+// Rewrites every endpoint to a 0-based vertex ID and returns the number of
+// vertices.
+inline uint64_t relabel_vertices(std::vector<std::pair<uint64_t, uint64_t>>& edges,
+        relabel_mode mode) {
+    switch (mode) {
+        case relabel_mode::first_seen: return relabel_first_seen(edges);
+        case relabel_mode::sorted: return relabel_sorted(edges);
+        case relabel_mode::none: return relabel_none(edges);
+    }
+    return 0;
+}
+
+// Rewrites the first and second member of every pair to 0-based IDs of two
+// separate ranges and returns the sizes of the two ranges.
+inline std::pair<uint64_t, uint64_t> relabel_bipartite(std::vector<std::pair<uint64_t, uint64_t>>& pairs,
+        relabel_mode mode) {
+    // Each side is relabeled as a list of self pairs, which the modes number
+    // exactly like the side itself.
+    std::vector<std::pair<uint64_t, uint64_t>> side(pairs.size());
+#pragma omp parallel for
+    for (size_t i = 0; i < pairs.size(); ++i)
+        side[i] = {pairs[i].first, pairs[i].first};
+    const uint64_t num_first = relabel_vertices(side, mode);
+#pragma omp parallel for
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        pairs[i].first = side[i].first;
+        side[i]        = {pairs[i].second, pairs[i].second};
+    }
+    const uint64_t num_second = relabel_vertices(side, mode);
+#pragma omp parallel for
+    for (size_t i = 0; i < pairs.size(); ++i)
+        pairs[i].second = side[i].first;
+    return {num_first, num_second};
+}
@@ -0,0 +1,221 @@
+// Builds the s-line graphs of a hypergraph file (see hypergraph-converter)
+// for several s at once. Two hyperedges are adjacent in the s-line graph if
+// they share at least s vertices; with --side vertices the roles swap and
+// two vertices are adjacent if they share at least s hyperedges.
+//
+// Every hyperedge e counts its overlaps with the hyperedges f > e through the
+// two-hop walk e -> v -> f in a per-thread sparse accumulator: a dense array
+// of counts over all hyperedges and the list of the ones touched, which is
+// all that is reset afterwards. The walk is cut short where no overlap can
+// reach the smallest s:
+//
+//   hyperedges with fewer than s vertices are skipped as e and as f
+//   rows are sorted, so the f <= e of every vertex are skipped by a search
+//   once fewer than s vertices of e are left, f not yet seen are not counted
+//
+// One pass yields every overlap of at least the smallest s, from which each
+// s-line graph is written as a symmetric CSR file in the [chgl] layout, with
+// the IDs of the hyperedges (or vertices) as its vertex IDs.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "csr_builder.hpp"
+#include "csr_format.hpp"
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+
+typedef uint64_t IndexType;
+std::string hypergraphFile = "";
+std::string sValues = "1";
+std::string side = "edges";
+
+// Two members of the line graph and the number of members of the other side
+// they share, a < b.
+struct overlap {
+    uint64_t a, b;
+    uint64_t count;
+};
+
+// Incidence of the side whose line graph is built (rows) and of the other
+// side (back), as stored in the file.
+template<typename Id>
+struct incidence {
+    uint64_t        num_rows;
+    const uint64_t* row_offsets;
+    const Id*       rows;
+    const uint64_t* back_offsets;
+    const Id*       back;
+
+    uint64_t degree(uint64_t r) const { return row_offsets[r + 1] - row_offsets[r]; }
+};
+
+// Returns every pair of rows that share at least s_min members.
+template<typename Id>
+std::vector<overlap> count_overlaps(const incidence<Id>& g, uint64_t s_min, uint64_t& walked) {
+    std::vector<std::vector<overlap>> found(max_threads());
+    uint64_t                          steps = 0;
+#pragma omp parallel reduction(+ : steps)
+    {
+        int thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+        std::vector<overlap>& mine = found[thread];
+        std::vector<uint64_t> count(g.num_rows, 0);
+        std::vector<uint64_t> touched;
+
+#pragma omp for schedule(dynamic, 256)
+        for (uint64_t e = 0; e < g.num_rows; ++e) {
+            const uint64_t length = g.degree(e);
+            if (length < s_min) continue;
+            const Id* members = g.rows + g.row_offsets[e];
+            for (uint64_t i = 0; i < length; ++i) {
+                // members of e left after this one, counting it
+                const bool     admit = length - i >= s_min;
+                const uint64_t v     = members[i];
+                const Id*      first = g.back + g.back_offsets[v];
+                const Id*      last  = g.back + g.back_offsets[v + 1];
+                for (const Id* f = std::upper_bound(first, last, static_cast<Id>(e)); f != last; ++f) {
+                    ++steps;
+                    if (count[*f] == 0) {
+                        if (!admit || g.degree(*f) < s_min) continue;
+                        touched.push_back(*f);
+                    }
+                    ++count[*f];
+                }
+            }
+            for (uint64_t f : touched) {
+                if (count[f] >= s_min) mine.push_back(overlap{e, f, count[f]});
+                count[f] = 0;
+            }
+            touched.clear();
+        }
+    }
+    walked = steps;
+
+    std::vector<size_t> starts(found.size() + 1, 0);
+    for (size_t t = 0; t < found.size(); ++t)
+        starts[t + 1] = starts[t] + found[t].size();
+    std::vector<overlap> all(starts.back());
+#pragma omp parallel for schedule(static, 1)
+    for (size_t t = 0; t < found.size(); ++t) {
+        std::copy(found[t].begin(), found[t].end(), all.begin() + starts[t]);
+        std::vector<overlap>().swap(found[t]);
+    }
+    return all;
+}
+
+// Writes the s-line graph of the overlaps of at least s with Id-wide IDs.
+template<typename Id>
+void write_line_graph(const std::vector<overlap>& overlaps, uint64_t s, uint64_t num_vertices,
+        const std::string& opath) {
+    std::vector<std::pair<uint64_t, uint64_t>> edges;
+    for (const overlap& o : overlaps)
+        if (o.count >= s) edges.emplace_back(o.a, o.b);
+    const size_t num_links = edges.size();
+
+    csr_graph<Id> csr;
+    build_symmetric_csr(edges, num_vertices, csr);
+    const uint64_t num_edges = csr.num_edges();
+
+    std::ofstream outfile(opath, std::ofstream::binary);
+    write_csr_file_header(outfile, make_csr_file_header(uncompressed, num_vertices, num_edges,
+            num_edges * sizeof(Id), sizeof(Id)));
+    outfile.write(reinterpret_cast<const char*>(csr.offsets.data()), sizeof(IndexType)*csr.offsets.size());
+    outfile.write(reinterpret_cast<const char*>(csr.adjacency.data()), sizeof(Id)*csr.adjacency.size());
+    std::cout << "s = " << s << ": " << num_links << " links, wrote " << opath << std::endl;
+}
+
+template<typename Id>
+void build_line_graphs(const mapped_file& file, const hypergraph_file_header& h,
+        const std::vector<uint64_t>& s_list) {
+    const char* data         = file.begin();
+    const auto* vertex_offs  = reinterpret_cast<const uint64_t*>(data + hypergraph_vertex_offsets_pos(h));
+    const auto* edge_offs    = reinterpret_cast<const uint64_t*>(data + hypergraph_edge_offsets_pos(h));
+    const auto* vertex_rows  = reinterpret_cast<const Id*>(data + hypergraph_vertex_rows_pos(h));
+    const auto* edge_rows    = reinterpret_cast<const Id*>(data + hypergraph_edge_rows_pos(h));
+
+    incidence<Id> g;
+    if (side == "edges") {
+        g = incidence<Id>{h.num_edges, edge_offs, edge_rows, vertex_offs, vertex_rows};
+    } else if (side == "vertices") {
+        g = incidence<Id>{h.num_vertices, vertex_offs, vertex_rows, edge_offs, edge_rows};
+    } else {
+        std::cerr << "Unknown side: " << side << std::endl;
+        abort();
+    }
+
+    const auto           start   = std::chrono::steady_clock::now();
+    uint64_t             walked  = 0;
+    std::vector<overlap> overlaps = count_overlaps(g, s_list.front(), walked);
+    const double         seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Counted " << overlaps.size() << " overlaps of at least " << s_list.front() << " in "
+              << seconds << " s (" << walked << " two-hop steps)" << std::endl;
+
+    // The line graph has a vertex per row, so its IDs are never wider than
+    // the file's.
+    for (uint64_t s : s_list) {
+        const std::string opath = hypergraphFile + "_" + side + "_s" + std::to_string(s) + "_csr.bin";
+        if (csr_id_bytes(g.num_rows) == sizeof(uint32_t))
+            write_line_graph<uint32_t>(overlaps, s, g.num_rows, opath);
+        else
+            write_line_graph<uint64_t>(overlaps, s, g.num_rows, opath);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int argIndex = 1;
+
+    while (argIndex < argc) {
+        std::string arg(argv[argIndex]);
+        if (arg == "--hypergraphfile") {
+            ++argIndex;
+            hypergraphFile = std::string(argv[argIndex]);
+            ++argIndex;
+        } else if (arg == "--s") {
+            ++argIndex;
+            sValues = std::string(argv[argIndex]);
+            ++argIndex;
+        } else if (arg == "--side") {
+            ++argIndex;
+            side = std::string(argv[argIndex]);
+            ++argIndex;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // "1,2,4" -> {1, 2, 4}
+    std::vector<uint64_t> s_list;
+    std::stringstream     values(sValues);
+    for (std::string value; std::getline(values, value, ',');)
+        s_list.push_back(std::stoull(value));
+    std::sort(s_list.begin(), s_list.end());
+    s_list.erase(std::unique(s_list.begin(), s_list.end()), s_list.end());
+    if (s_list.empty() || s_list.front() == 0) { std::cerr << "s must be at least 1" << std::endl; abort(); }
+
+    mapped_file            file(hypergraphFile, MADV_RANDOM);
+    hypergraph_file_header h;
+    parse_hypergraph_file_header(file.begin(), file.size(), h);
+    std::cout << "Num vertices: " << h.num_vertices << "\n";
+    std::cout << "Num hyperedges: " << h.num_edges << "\n";
+    std::cout << "Inclusions: " << h.num_inclusions << "\n";
+
+    if (h.id_bytes == sizeof(uint32_t))
+        build_line_graphs<uint32_t>(file, h, s_list);
+    else
+        build_line_graphs<uint64_t>(file, h, s_list);
+}
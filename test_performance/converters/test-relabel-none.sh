@@ -0,0 +1,59 @@
+#!/bin/sh
+#
+# Checks that --relabel none rejects sparse vertex IDs, in memory and with
+# --memory-budget, before any output is written, and that a dense input
+# converts to the same file on both paths.
+#
+# Usage: ./test-relabel-none.sh   (run from test_performance/converters)
+
+set -u
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+fail() {
+    echo "FAIL: $*"
+    status=1
+}
+
+g++ -std=c++14 -O3 -fopenmp -o "$dir/converter" vertex-and-edge-count-converter.cpp || exit 1
+
+# IDs up to 1e15 for 3 edges
+cat > "$dir/sparse.mtx" <<EOF
+%%MatrixMarket matrix coordinate pattern general
+1000000000000000 1000000000000000 3
+1 2
+2 1000000000000000
+3 500000000000000
+EOF
+
+# a 4-cycle, 1-based and dense
+cat > "$dir/dense.mtx" <<EOF
+%%MatrixMarket matrix coordinate pattern general
+4 4 4
+1 2
+2 3
+3 4
+4 1
+EOF
+
+for budget in "" "--memory-budget 1M"; do
+    rm -f "$dir/sparse.mtx_csr.bin"
+    # a regression would stream a petabyte-sized offsets array
+    if timeout 60 "$dir/converter" --edgelistfile "$dir/sparse.mtx" --relabel none $budget \
+            > "$dir/out" 2> "$dir/err"; then
+        fail "sparse IDs accepted ${budget:-in memory}"
+    fi
+    grep -q "too sparse" "$dir/err" || fail "no sparse-ID error ${budget:-in memory}: $(cat "$dir/err")"
+    [ -e "$dir/sparse.mtx_csr.bin" ] && fail "output written for sparse IDs ${budget:-in memory}"
+    ls "$dir" | grep -q '\.run' && fail "runs left behind ${budget:-in memory}"
+done
+
+"$dir/converter" --edgelistfile "$dir/dense.mtx" --relabel none > /dev/null || fail "dense input rejected in memory"
+mv "$dir/dense.mtx_csr.bin" "$dir/dense.in_memory"
+"$dir/converter" --edgelistfile "$dir/dense.mtx" --relabel none --memory-budget 1M > /dev/null \
+        || fail "dense input rejected with --memory-budget"
+cmp -s "$dir/dense.mtx_csr.bin" "$dir/dense.in_memory" || fail "in-memory and external outputs differ"
+
+[ $status -eq 0 ] && echo "PASS"
+exit $status
@@ -7,46 +7,85 @@
 #include <algorithm>
 #include <limits>
 #include <mutex>
-#include <map>
 #include <regex>
 
+#include "csr_builder.hpp"
+#include "csr_compressed.hpp"
+#include "csr_format.hpp"
+#include "mtx_reader.hpp"
+#include "relabel.hpp"
+
 typedef unsigned long long ve_type;
 typedef uint64_t IndexType;
 std::string edgelistFile = "";
+std::string ingestMode = "mmap";
+std::string relabelMode = "first-seen";
+bool compressOutput = false;
+bool legacyHeader = false;
+std::string idWidth = "auto";
 
 using element = std::tuple<ve_type, ve_type>;
-template<typename Adjacencies, typename Vertex>
-void update_adjacencies(Adjacencies& adj, Vertex src, Vertex dst) {
-    //  std::cout << "Updating link " << src << " " << dst << "\n";
-    if (src >= adj.size()) {
-        adj.resize(src + 1);
-        adj.back().first = src;
+
+// Builds the CSR with Id-wide neighbor IDs and writes it.
+template<typename Id>
+void write_csr(std::vector<mtx_edge>& edges, IndexType num_vertices) {
+    csr_graph<Id> csr;
+    size_t removed_count = build_symmetric_csr(edges, num_vertices, csr);
+    size_t num_edges = csr.num_edges();
+
+    std::cout << "Removed " << removed_count << " duplicate adjacencies" << std::endl;
+
+    if (compressOutput) {
+        std::string cpath = edgelistFile + "_csrz.bin";
+        compressed_csr_writer writer(cpath, num_vertices, sizeof(Id));
+        for (IndexType v = 0; v < num_vertices; ++v)
+            writer.add_row(csr.adjacency.data() + csr.offsets[v], csr.offsets[v + 1] - csr.offsets[v]);
+        writer.finish();
+        std::cout << "Wrote " << writer.payload_bytes() << " bytes of compressed adjacencies to " << cpath << std::endl;
+        return;
     }
-    adj[src].second.push_back(dst);
-}
 
-template<typename Sequence>
-size_t clean_sort(Sequence& adjacencies, std::vector<IndexType>& offsets,
-        IndexType num_edges, size_t &newEdges) {
-    size_t removed_count{0};
-    for (auto& adj_pair : adjacencies) {
-        auto& adj_list = adj_pair.second;
-        std::sort(adj_list.begin(), adj_list.end());
-        auto last = std::unique(adj_list.begin(), adj_list.end());
-        removed_count += adj_list.end() - last;
-        adj_list.erase(last, adj_list.end());
-        num_edges += adj_list.size();
-        offsets.push_back(num_edges);
+    // Binary output data format:
+    // csr_file_header (48bytes, see csr_format.hpp), or with --legacy-header
+    // Num_vertices  (8bytes)
+    // Offsets_array [(Num_vertices + 1)*8bytes] (first element 0)
+    // adjacency_lists [Num_edges*sizeof(Id)bytes] ...
+    std::string opath = edgelistFile + "_csr.bin";
+
+    std::ofstream outfile(opath, std::ofstream::binary);
+    if (legacyHeader) {
+        outfile.write(reinterpret_cast<char*>(&num_vertices), sizeof(num_vertices));
+    } else {
+        write_csr_file_header(outfile, make_csr_file_header(uncompressed, num_vertices, num_edges,
+                num_edges * sizeof(Id), sizeof(Id)));
     }
-    newEdges = num_edges;
-    return removed_count;
-}
+    outfile.write(reinterpret_cast<char*>(csr.offsets.data()), sizeof(IndexType)*csr.offsets.size());
+
+#if 0
+    std::ofstream outfile_asc(opath + std::string(".cleaned_csr.asc"));
+    outfile_asc << num_vertices << std::endl << "offsets: ";
+    for (auto offset : csr.offsets)
+        outfile_asc << "\t" << offset;
+    outfile_asc << std::endl;
+#endif
 
+    outfile.write(reinterpret_cast<char*>(csr.adjacency.data()), sizeof(Id)*csr.adjacency.size());
+
+#if 0
+    for (IndexType v = 0; v < num_vertices; ++v)
+    {
+        outfile_asc << v << ": ";
+        for (auto i = csr.offsets[v]; i < csr.offsets[v + 1]; ++i)
+            outfile_asc << "\t" << csr.adjacency[i];
+        outfile_asc << std::endl;
+    }
+#endif
+}
 
 int main(int argc, char* argv[]) {
     ve_type nVertices, nEdges;
     ve_type source;
-    unsigned argIndex = 1;
+    int argIndex = 1;
     std::string arg_t(argv[argIndex]);
 
     while (argIndex < argc) {
@@ -55,131 +94,64 @@ int main(int argc, char* argv[]) {
             ++argIndex;
             edgelistFile = std::string(argv[argIndex]);
             ++argIndex;
+        } else if (arg == "--ingest") {
+            ++argIndex;
+            ingestMode = std::string(argv[argIndex]);
+            ++argIndex;
+        } else if (arg == "--relabel") {
+            ++argIndex;
+            relabelMode = std::string(argv[argIndex]);
+            ++argIndex;
+        } else if (arg == "--compress") {
+            ++argIndex;
+            compressOutput = true;
+        } else if (arg == "--legacy-header") {
+            ++argIndex;
+            legacyHeader = true;
+        } else if (arg == "--id-width") {
+            ++argIndex;
+            idWidth = std::string(argv[argIndex]);
+            ++argIndex;
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
         }
 
     }
     // edgelist                                                           
-    IndexType max_vertex_id{0};
-    std::map<IndexType, IndexType> vertex_old_new_map;
-    std::vector<std::pair<IndexType, std::vector<IndexType>>> vertex_adjacencies;
-
-    IndexType num_links = 0;
-    IndexType vrt, edg;
-    // std::ifstream infile(edgelistFile);
-    IndexType next_vertex_id{0}, next_edge_id{0};
-    std::string line;
-
-    std::string              string_input;
-    bool                     file_symmetry = false;
-    std::vector<std::string> header(5);
-    std::ifstream inputFile(edgelistFile);
-    std::getline(inputFile, string_input);
-    std::stringstream h(string_input);
-    for (auto& s : header)
-        h >> s;
-
-    if (header[0] != "%%MatrixMarket") {
-        std::cerr << "Unsupported format" << std::endl;
-        throw;
-    }
-    if (header[4] == "symmetric") {
-        file_symmetry = true;
-    } else if (header[4] == "general") {
-        file_symmetry = false;
+    mtx_header            mtx;
+    std::vector<mtx_edge> edges;
+    if (ingestMode == "mmap") {
+        read_mtx_mmap(edgelistFile, mtx, edges);
+    } else if (ingestMode == "stream") {
+        read_mtx_stream(edgelistFile, mtx, edges);
     } else {
-        std::cerr << "Bad format (symmetry): " << header[4] << std::endl;
-        throw;
+        std::cerr << "Unknown ingest mode: " << ingestMode << std::endl;
+        abort();
     }
 
-    while (std::getline(inputFile, string_input)) {
-        if (string_input[0] != '%') break;
-    }
-    size_t n0, n1, nNonzeros;
-    std::stringstream(string_input) >> n0 >> n1 >> nNonzeros;
-
     //assert(n0 == n1);
-    nVertices = n0;
-    nEdges = nNonzeros;
-
-    for (size_t i = 0; i < nNonzeros; ++i) {
-        std::string buffer;
-        size_t      src, dst;
-
-        std::getline(inputFile, buffer);
-        std::stringstream(buffer) >> src >> dst;
-        // std::cout << src << " " << dst << std::endl;
-
-        if (src != dst) {
-            ++num_links;
-            IndexType new_src = src, new_dst = dst;
-
-            // std::cout << "Read link: " << new_src << " " << new_dst << "\n";
-
-            if (vertex_old_new_map.find(src) == vertex_old_new_map.end()) {
-                new_src = next_vertex_id++;
-                vertex_old_new_map[src] = new_src;
-            }
-            else {
-                new_src = vertex_old_new_map[src];
-            }
-            //    std::cout << "Transformed link: " << new_src << " " << new_dst << "\n";
-
-            if (vertex_old_new_map.find(dst) == vertex_old_new_map.end()) {
-                new_dst = next_vertex_id++;
-                vertex_old_new_map[dst] = new_dst;
-            }
-            else {
-                new_dst = vertex_old_new_map[dst];
-            }
-            update_adjacencies(vertex_adjacencies, new_src, new_dst);
-            update_adjacencies(vertex_adjacencies, new_dst, new_src);
-            max_vertex_id = std::max({max_vertex_id, new_src, new_dst});
-
-            if ((num_links % 100000) == 0) {
-                std::cout << "Read " << num_links << " dstes." << std::endl;
-            }
-        }
-    }
+    nVertices = mtx.n0;
+    nEdges = mtx.nNonzeros;
+
+    // Self loops are dropped before renumbering so that vertices that only
+    // have self loops do not get an ID.
+    edges.erase(std::remove_if(edges.begin(), edges.end(),
+                [](const mtx_edge& e) { return e.first == e.second; }),
+            edges.end());
+    IndexType num_links = edges.size();
     if (num_links == 0) { std::cerr << "No lines read from the file" << std::endl; abort(); }
 
-    IndexType num_vertices = max_vertex_id + 1;
+    IndexType num_vertices = relabel_vertices(edges, parse_relabel_mode(relabelMode));
+
     std::cout << "Read " << num_links << " links.\n";
     std::cout << "Num vertices: " << num_vertices << "\n";
 
-    size_t removed_count{0};
-    size_t num_edges = 0;
-    std::vector<IndexType> offsets(1, 0);
-    removed_count += clean_sort(vertex_adjacencies, offsets, num_edges, num_edges);
-
-    std::cout << "Removed " << removed_count << " duplicate adjacencies" << std::endl;
-
-    // Binary output data format:
-    // Num_vertices  (8bytes)
-    // Offsets_array [(Num_vertices + 1)*8bytes] (first element 0)
-    // adjacency_lists ...
-    std::string opath = edgelistFile + "_csr.bin";
-
-    std::ofstream outfile(opath, std::ofstream::binary);
-    outfile.write(reinterpret_cast<char*>(&num_vertices), sizeof(num_vertices));
-    outfile.write(reinterpret_cast<char*>(offsets.data()), sizeof(IndexType)*offsets.size());
-
-#if 0
-    std::ofstream outfile_asc(opath + std::string(".cleaned_csr.asc"));
-    outfile_asc << next_vertex_id << std::endl << "offsets: ";
-    for (auto offset : offsets)
-        outfile_asc << "\t" << offset;
-    outfile_asc << std::endl;
-#endif
-
-    for (auto &adj_list : vertex_adjacencies)
-    {
-        outfile.write(reinterpret_cast<char*>(adj_list.second.data()), sizeof(IndexType)*adj_list.second.size());
-
-#if 0
-        outfile_asc << adj_list.first << ": ";
-        for (auto &adj : adj_list.second)
-            outfile_asc << "\t" << adj;
-        outfile_asc << std::endl;
-#endif
-    }
+    // The legacy layouts always hold 64-bit IDs.
+    const uint32_t id_bytes = legacyHeader ? sizeof(uint64_t) : parse_id_bytes(idWidth, num_vertices);
+    std::cout << "Vertex ID width: " << 8 * id_bytes << " bits\n";
+    if (id_bytes == sizeof(uint32_t))
+        write_csr<uint32_t>(edges, num_vertices);
+    else
+        write_csr<uint64_t>(edges, num_vertices);
 }
@@ -0,0 +1,216 @@
+// Per-rank software cache of remote adjacency lists.
+//
+// fetch(v) returns a future of the adjacency list of a vertex owned by
+// another rank. A list that is cached is returned without communication; a
+// list that is already being fetched is not fetched again, every request for
+// it shares the one in-flight future. Completed lists are kept until their
+// total size exceeds the byte budget, and are then evicted either least
+// recently used first or by a degree-weighted policy that keeps hubs, which
+// are requested most often on power-law graphs, resident for longer.
+//
+// The offsets of missed vertices are fetched a block at a time through
+// offset_blocks (flow_control.hpp).
+//
+// Lists are handed out as shared pointers, so an evicted list stays valid
+// for the callbacks still using it. The cache is used from the thread that
+// drives progress only, as UPC++ callbacks run there.
+
+#pragma once
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "csr_loader.hpp"
+#include "flow_control.hpp"
+#include "instrumentation.hpp"
+
+enum class cache_policy {
+  // evict the least recently used list
+  lru,
+  // GreedyDual with the degree as the value of a list: a list is worth its
+  // degree plus the value of the last list evicted before its last use, so
+  // low-degree lists go first but unused hubs age out
+  degree
+};
+
+inline cache_policy parse_cache_policy(const std::string& policy) {
+  if (policy == "lru") return cache_policy::lru;
+  if (policy == "degree") return cache_policy::degree;
+  throw std::runtime_error("Unknown cache policy: " + policy);
+}
+
+struct adjacency_cache_stats {
+  // requests served from a completed list
+  uint64_t hits = 0;
+  // requests that joined a fetch already in flight
+  uint64_t coalesced = 0;
+  // requests that started a fetch
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  // rgets of offset blocks (see offset_blocks)
+  uint64_t offset_blocks = 0;
+  // offset and adjacency bytes transferred
+  uint64_t bytes_fetched = 0;
+};
+
+template <typename Id>
+class adjacency_cache {
+public:
+  using list_ptr = std::shared_ptr<const std::vector<Id>>;
+
+  adjacency_cache(const distributed_csr<Id>& graph, size_t budget_bytes,
+                  cache_policy policy = cache_policy::lru,
+                  size_t offset_block_length = 1024)
+      : offsets(graph, offset_block_length),
+        budget_bytes(budget_bytes),
+        policy(policy) {}
+
+  // The adjacency list of vertex_id, which must be owned by another rank.
+  upcxx::future<list_ptr> fetch(uint64_t vertex_id) {
+    auto found = entries.find(vertex_id);
+    if (found != entries.end()) {
+      entry& e = found->second;
+      if (!e.list) {
+        ++counters.coalesced;
+        return e.pending;
+      }
+      ++counters.hits;
+      e.priority = priority(e);
+      return upcxx::make_future(e.list);
+    }
+
+    ++counters.misses;
+    entries[vertex_id];    // in flight from here on
+    upcxx::future<list_ptr> fetched =
+        offsets.fetch(vertex_id)
+            .then([this](gptr_and_len<Id> pn) {
+              auto list = std::make_shared<std::vector<Id>>(pn.n);
+              counters.bytes_fetched += pn.n * sizeof(Id);
+              note_one_sided(pn.p.where(), pn.n * sizeof(Id));
+              return upcxx::rget(pn.p, list->data(), pn.n).then([list]() {
+                return list_ptr(list);
+              });
+            })
+            .then([this, vertex_id](list_ptr list) {
+              complete(vertex_id, list);
+              return list;
+            });
+    // The fetch may already have completed, and the entry been dropped.
+    found = entries.find(vertex_id);
+    if (found != entries.end() && !found->second.list) {
+      found->second.pending = fetched;
+    }
+    return fetched;
+  }
+
+  // The offsets the cache finds its lists with.
+  offset_blocks<Id>& offsets_of_lists() { return offsets; }
+
+  adjacency_cache_stats stats() const {
+    adjacency_cache_stats all = counters;
+    all.offset_blocks = offsets.blocks_fetched();
+    all.bytes_fetched += offsets.bytes_fetched();
+    return all;
+  }
+
+  // Bytes of the completed lists currently cached.
+  size_t cached_bytes() const { return bytes; }
+
+private:
+  // (priority, vertex): the smallest key is evicted first. Priorities only
+  // grow; a hit updates the priority of its entry but not its key, which is
+  // brought up to date when it reaches the front of the order, so a hit
+  // costs no reordering.
+  using eviction_key = std::pair<uint64_t, uint64_t>;
+
+  struct entry {
+    upcxx::future<list_ptr> pending;
+    // null while the fetch is in flight
+    list_ptr                list;
+    uint64_t                priority = 0;
+  };
+
+  // The priority of a list used now.
+  uint64_t priority(const entry& e) {
+    return policy == cache_policy::lru ? ++clock : inflation + e.list->size();
+  }
+
+  void complete(uint64_t vertex_id, const list_ptr& list) {
+    auto         found      = entries.find(vertex_id);
+    entry&       e          = found->second;
+    const size_t list_bytes = list->size() * sizeof(Id);
+    if (list_bytes > budget_bytes) {
+      // Never cached; the requests already waiting still get the list.
+      entries.erase(found);
+      return;
+    }
+    e.list     = list;
+    e.pending  = upcxx::future<list_ptr>();
+    e.priority = priority(e);
+    order.insert(eviction_key(e.priority, vertex_id));
+    bytes += list_bytes;
+    while (bytes > budget_bytes) evict();
+  }
+
+  void evict() {
+    for (;;) {
+      const eviction_key key   = *order.begin();
+      auto               found = entries.find(key.second);
+      order.erase(order.begin());
+      if (key.first == found->second.priority) {
+        if (policy == cache_policy::degree) inflation = key.first;
+        bytes -= found->second.list->size() * sizeof(Id);
+        entries.erase(found);
+        ++counters.evictions;
+        return;
+      }
+      // Used since it was keyed; requeue it at its true position.
+      order.insert(eviction_key(found->second.priority, key.second));
+    }
+  }
+
+  offset_blocks<Id>                   offsets;
+  const size_t                        budget_bytes;
+  const cache_policy                  policy;
+  std::unordered_map<uint64_t, entry> entries;
+  std::set<eviction_key>              order;
+  size_t                              bytes = 0;
+  uint64_t                            clock = 0;
+  uint64_t                            inflation = 0;
+  adjacency_cache_stats               counters;
+};
+
+// Sums the counters of all ranks and prints them on rank 0.
+inline void report_cache_stats(const adjacency_cache_stats& stats) {
+  const uint64_t local[6] = {stats.hits,      stats.coalesced,
+                             stats.misses,    stats.evictions,
+                             stats.offset_blocks,
+                             stats.bytes_fetched};
+  uint64_t       total[6] = {0, 0, 0, 0, 0, 0};
+  upcxx::reduce_one(local, total, 6,
+                    [](uint64_t a, uint64_t b) { return a + b; }, 0)
+      .wait();
+  if (upcxx::rank_me() == 0) {
+    const uint64_t requests = total[0] + total[1] + total[2];
+    std::cout << "Adjacency cache: " << requests << " requests, " << total[0]
+              << " hits, " << total[1] << " coalesced, " << total[2]
+              << " misses, " << total[3] << " evictions, " << total[4]
+              << " offset blocks, " << total[5] << " bytes fetched";
+    if (requests > 0) {
+      std::cout << " (" << std::fixed << std::setprecision(1)
+                << 100.0 * (total[0] + total[1]) / requests << "% served "
+                << "without a fetch)";
+    }
+    std::cout << std::endl;
+  }
+}
@@ -0,0 +1,207 @@
+// Asynchronous label-correcting traversal (BFS and SSSP) over UPC++ RPC.
+//
+// There are no levels and no per-level collectives. Every rank keeps the
+// tentative distance and parent of its vertices and works through its own
+// delta-stepping buckets: the lowest non-empty bucket is drained first, and
+// a vertex is relaxed again whenever its distance has dropped since its last
+// relaxation. Relaxations of remote neighbors are aggregated per owner rank
+// and sent as one upcxx::rpc_ff of up to batch_updates updates, when the
+// batch is full or when the rank runs out of local work. The handler only
+// lowers labels and files the improved vertices into buckets; they are
+// relaxed by the owner's work loop.
+//
+// Termination is detected as in TerminationDetection.chpl: every rank counts
+// the batches it has sent and the batches it has handled. Whenever it is
+// idle, a rank contributes its counts to a non-blocking reduce_all and keeps
+// working while the reduction completes. The traversal is over once two
+// consecutive reductions agree with each other and sent equals handled, so
+// that no batch was in flight and no rank did any work in between.
+//
+// BFS is the special case of unit weights and delta 1, which makes every
+// bucket a BFS level. Weighted runs take their weights from edge_weight.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "csr_loader.hpp"
+#include "instrumentation.hpp"
+
+const uint64_t unreached = std::numeric_limits<uint64_t>::max();
+
+// Weight of the undirected edge {u, v}, uniform in [1, max_weight]. The CSR
+// files carry no weights, so they are derived from a hash of the endpoints,
+// which gives both directions of an edge the same weight on every rank.
+inline uint64_t edge_weight(uint64_t u, uint64_t v, uint64_t max_weight) {
+  uint64_t h = std::min(u, v) * 0x9E3779B97F4A7C15ull + std::max(u, v);
+  h ^= h >> 30;
+  h *= 0xBF58476D1CE4E5B9ull;
+  h ^= h >> 27;
+  h *= 0x94D049BB133111EBull;
+  h ^= h >> 31;
+  return 1 + h % max_weight;
+}
+
+// Proposed distance and parent for a vertex of the destination rank.
+template <typename Id>
+struct relaxation {
+  Id       offset;    // local index of the target on its owner
+  Id       parent;
+  uint64_t distance;
+};
+
+template <typename Id>
+class async_traversal {
+public:
+  // Collective: every rank constructs its engine at the same point.
+  // max_weight 1 with delta 1 is BFS.
+  async_traversal(const distributed_csr<Id>& graph, uint64_t max_weight,
+                  uint64_t delta, size_t batch_updates)
+      : graph(graph),
+        max_weight(std::max<uint64_t>(max_weight, 1)),
+        delta(std::max<uint64_t>(delta, 1)),
+        batch_updates(std::max<size_t>(batch_updates, 1)),
+        self(this),
+        distance(graph.num_vertices_per_rank, unreached),
+        relaxed(graph.num_vertices_per_rank, unreached),
+        parent(graph.num_vertices_per_rank),
+        batches(upcxx::rank_n()) {}
+
+  // Collective: computes distances and parents from source.
+  void run(uint64_t source) {
+    if (vertex_id_to_rank(source) == upcxx::rank_me()) {
+      lower(vertex_id_to_offset(source), 0, static_cast<Id>(source));
+    }
+
+    upcxx::future<> wave;
+    bool            wave_pending = false;
+    uint64_t        last[2]      = {unreached, unreached};
+    while (true) {
+      work();
+      if (!wave_pending) {
+        counts[0]    = sent;
+        counts[1]    = handled;
+        wave         = upcxx::reduce_all(counts, totals, 2,
+                                 [](uint64_t a, uint64_t b) { return a + b; });
+        wave_pending = true;
+        ++waves;
+      }
+      upcxx::progress();
+      if (wave_pending && wave.ready()) {
+        wave_pending = false;
+        if (totals[0] == totals[1] && totals[0] == last[0] &&
+            totals[1] == last[1]) {
+          break;
+        }
+        last[0] = totals[0];
+        last[1] = totals[1];
+      }
+    }
+  }
+
+  // Distance and parent of the vertex of local index (unreached if none).
+  uint64_t distance_of(uint64_t index) const { return distance[index]; }
+  Id       parent_of(uint64_t index) const { return parent[index]; }
+
+  // Vertex relaxations (including repeated ones), updates and batches
+  // sent, and termination reductions started by this rank.
+  uint64_t relaxations() const { return relaxed_vertices; }
+  uint64_t updates_sent() const { return sent_updates; }
+  uint64_t batches_sent() const { return sent; }
+  uint64_t reductions() const { return waves; }
+
+private:
+  // Lowers the distance of local vertex index if d improves it.
+  void lower(uint64_t index, uint64_t d, Id p) {
+    if (d >= distance[index]) return;
+    distance[index] = d;
+    parent[index]   = p;
+    const uint64_t b = d / delta;
+    if (b >= buckets.size()) buckets.resize(b + 1);
+    buckets[b].push_back(index);
+    current = std::min<uint64_t>(current, b);
+  }
+
+  // Relaxes local vertices, lowest bucket first, until none is left, and
+  // then sends every partial batch.
+  void work() {
+    uint64_t since_progress = 0;
+    while (current < buckets.size()) {
+      if (buckets[current].empty()) {
+        ++current;
+        continue;
+      }
+      const uint64_t index = buckets[current].back();
+      buckets[current].pop_back();
+      if (distance[index] >= relaxed[index]) continue;    // stale entry
+      relax(index);
+      // let incoming batches lower labels while this rank is busy
+      if (++since_progress % 64 == 0) upcxx::progress();
+    }
+    for (upcxx::intrank_t r = 0; r < upcxx::rank_n(); ++r) {
+      if (!batches[r].empty()) send(r);
+    }
+  }
+
+  void relax(uint64_t index) {
+    const uint64_t d = relaxed[index] = distance[index];
+    const Id       v = index_to_vertex_id(index);
+    const auto&    row = graph.local(index);
+    const Id*      adj = row.p.local();
+    ++relaxed_vertices;
+    for (uint64_t j = 0; j < row.n; ++j) {
+      const uint64_t w = max_weight == 1 ? 1 : edge_weight(v, adj[j], max_weight);
+      const upcxx::intrank_t rank = vertex_id_to_rank(adj[j]);
+      if (rank == upcxx::rank_me()) {
+        lower(vertex_id_to_offset(adj[j]), d + w, v);
+      } else {
+        batches[rank].push_back(relaxation<Id>{
+            static_cast<Id>(vertex_id_to_offset(adj[j])), v, d + w});
+        if (batches[rank].size() >= batch_updates) send(rank);
+      }
+    }
+  }
+
+  void send(upcxx::intrank_t rank) {
+    std::vector<relaxation<Id>>& batch = batches[rank];
+    ++sent;
+    sent_updates += batch.size();
+    note_rpc(rank, batch.size() * sizeof(relaxation<Id>));
+    upcxx::rpc_ff(rank,
+                  [](upcxx::dist_object<async_traversal*>& engine,
+                     upcxx::view<relaxation<Id>>        updates) {
+                    for (const auto& u : updates) {
+                      (*engine)->lower(u.offset, u.distance, u.parent);
+                    }
+                    ++(*engine)->handled;
+                  },
+                  self, upcxx::make_view(batch.begin(), batch.end()));
+    batch.clear();
+  }
+
+  const distributed_csr<Id>&                graph;
+  const uint64_t                            max_weight;
+  const uint64_t                            delta;
+  const size_t                              batch_updates;
+  upcxx::dist_object<async_traversal*>      self;
+  std::vector<uint64_t>                     distance;
+  // distance each vertex was last relaxed at
+  std::vector<uint64_t>                     relaxed;
+  std::vector<Id>                           parent;
+  std::vector<std::vector<uint64_t>>        buckets;
+  uint64_t                                  current = 0;
+  std::vector<std::vector<relaxation<Id>>>  batches;
+  // counts contributed to, and totals of, the termination reduction
+  uint64_t                                  counts[2];
+  uint64_t                                  totals[2];
+  uint64_t                                  sent             = 0;
+  uint64_t                                  handled          = 0;
+  uint64_t                                  sent_updates     = 0;
+  uint64_t                                  relaxed_vertices = 0;
+  uint64_t                                  waves            = 0;
+};
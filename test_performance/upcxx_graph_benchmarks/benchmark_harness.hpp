@@ -0,0 +1,293 @@
+// Common timing and reporting for the UPC++ kernels.
+//
+// A kernel is divided into named phases. Loading runs once; the phases of
+// the kernel proper (compute and reduce) run inside
+//
+//   while (harness.next_repetition()) { ... }
+//
+// which makes --warmup untimed passes and then --repeat timed ones. Every
+// phase starts with a barrier and is timed on every rank with
+// std::chrono::steady_clock, so clock adjustments cannot skew it.
+//
+// report() gathers the times of all ranks. For every phase it reports the
+// wall time of each timed repetition (the slowest rank's time) as min,
+// median and max over the repetitions, and the median time of each rank as
+// min, median and max over the ranks, which shows imbalance. Rank 0 prints
+//
+//   Compute time: <median wall seconds> ...
+//
+// per phase, the form start_test's .perfkeys files pick values out of.
+// --json writes all of it to a file; --dat appends the medians to a file in
+// the layout of start_test's .dat files, so that .graph files in
+// test_performance/ can plot C++ and Chapel runs side by side.
+//
+// Built with -DGRAPH_INSTRUMENT, every phase is also a trace event, and
+// report() prints the counters of instrumentation.hpp for the last pass;
+// --comm-matrix and --trace write the communication matrix and the trace.
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "instrumentation.hpp"
+
+struct benchmark_options {
+  int         warmup      = 0;
+  int         repetitions = 1;
+  std::string json;           // JSON report file, if any
+  std::string dat;            // .dat file to append to, if any
+  std::string comm_matrix;    // communication matrix CSV file, if any
+  std::string trace;          // Chrome trace file, if any
+};
+
+// Consumes the harness option at argv[argIndex], if it is one, and returns
+// whether it was.
+inline bool parse_benchmark_option(char* argv[], int& argIndex,
+                                   benchmark_options& options) {
+  const std::string arg(argv[argIndex]);
+  if (arg == "--warmup") {
+    ++argIndex;
+    options.warmup = std::stoi(argv[argIndex]);
+    ++argIndex;
+    return true;
+  }
+  if (arg == "--repeat") {
+    ++argIndex;
+    options.repetitions = std::max(std::stoi(argv[argIndex]), 1);
+    ++argIndex;
+    return true;
+  }
+  if (arg == "--json") {
+    ++argIndex;
+    options.json = std::string(argv[argIndex]);
+    ++argIndex;
+    return true;
+  }
+  if (arg == "--dat") {
+    ++argIndex;
+    options.dat = std::string(argv[argIndex]);
+    ++argIndex;
+    return true;
+  }
+  if (arg == "--comm-matrix") {
+    ++argIndex;
+    options.comm_matrix = std::string(argv[argIndex]);
+    ++argIndex;
+    return true;
+  }
+  if (arg == "--trace") {
+    ++argIndex;
+    options.trace = std::string(argv[argIndex]);
+    ++argIndex;
+    return true;
+  }
+  return false;
+}
+
+class benchmark_harness {
+public:
+  benchmark_harness(const std::string& benchmark, const std::string& graph,
+                    const benchmark_options& options)
+      : benchmark(benchmark), graph(graph), options(options) {}
+
+  // Collective: starts timing phase after a barrier.
+  void start(const std::string& phase) {
+    upcxx::barrier();
+    if (phases.empty() && last.empty()) set_trace_epoch();
+    running        = phase;
+    started        = std::chrono::steady_clock::now();
+    phase_start_us = microseconds_since_epoch();
+  }
+
+  // Stops timing the running phase; times of warmup passes are dropped.
+  void stop() {
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                      started)
+            .count();
+    note_trace_event(running, phase_start_us);
+    last[running] = seconds;
+    if (pass > 0 && pass <= options.warmup) return;
+    if (!samples.count(running)) phases.push_back(running);
+    samples[running].push_back(seconds);
+  }
+
+  // Advances to the next pass, and returns false once all have run.
+  bool next_repetition() {
+    if (++pass > options.warmup + options.repetitions) return false;
+    // the counters describe the pass that ran last
+    reset_counters();
+    return true;
+  }
+
+  // Whether the current pass is the last, whose results a kernel prints.
+  bool last_repetition() const {
+    return pass == options.warmup + options.repetitions;
+  }
+
+  // This rank's time of the latest run of phase, in seconds.
+  double seconds(const std::string& phase) const { return last.at(phase); }
+
+  // Adds a result of the kernel to the JSON report (used on rank 0).
+  void metric(const std::string& name, double value) { metrics[name] = value; }
+
+  // Collective: reduces the times over ranks and reports them.
+  void report() {
+    std::vector<phase_stats> stats;
+    // per-rank medians of every phase, fetched by rank 0
+    std::vector<double> medians;
+    for (const std::string& phase : phases) {
+      medians.push_back(median(samples[phase]));
+    }
+    upcxx::dist_object<std::vector<double>> rank_medians(medians);
+
+    for (const std::string& phase : phases) {
+      const std::vector<double>& mine = samples[phase];
+      std::vector<double>        wall(mine.size());
+      upcxx::reduce_one(mine.data(), wall.data(), mine.size(),
+                        [](double a, double b) { return std::max(a, b); }, 0)
+          .wait();
+      phase_stats s;
+      s.name = phase;
+      s.wall = wall;
+      stats.push_back(s);
+    }
+    if (upcxx::rank_me() == 0) {
+      std::vector<std::vector<double>> by_phase(phases.size());
+      for (upcxx::intrank_t r = 0; r < upcxx::rank_n(); ++r) {
+        const std::vector<double> theirs = rank_medians.fetch(r).wait();
+        for (size_t p = 0; p < phases.size(); ++p) {
+          by_phase[p].push_back(theirs[p]);
+        }
+      }
+      for (size_t p = 0; p < phases.size(); ++p) stats[p].ranks = by_phase[p];
+      print(stats);
+      if (!options.json.empty()) write_json(stats);
+      if (!options.dat.empty()) append_dat(stats);
+    }
+    // rank 0 may still be fetching from the others
+    upcxx::barrier();
+    report_instrumentation(options.comm_matrix, options.trace);
+  }
+
+private:
+  struct phase_stats {
+    std::string         name;
+    std::vector<double> wall;     // per timed repetition
+    std::vector<double> ranks;    // per-rank medians
+  };
+
+  static double median(std::vector<double> values) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    const size_t half = values.size() / 2;
+    return values.size() % 2 ? values[half]
+                             : (values[half - 1] + values[half]) / 2;
+  }
+  static double least(const std::vector<double>& values) {
+    return values.empty() ? 0 : *std::min_element(values.begin(), values.end());
+  }
+  static double most(const std::vector<double>& values) {
+    return values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+  }
+
+  // "compute" -> "Compute time:"
+  static std::string perfkey(std::string phase) {
+    if (!phase.empty()) phase[0] = std::toupper(phase[0]);
+    return phase + " time:";
+  }
+
+  void print(const std::vector<phase_stats>& stats) const {
+    for (const phase_stats& s : stats) {
+      std::cout << perfkey(s.name) << ' ' << median(s.wall)
+                << " s (min " << least(s.wall) << ", max " << most(s.wall)
+                << " over " << s.wall.size() << " runs; rank medians "
+                << least(s.ranks) << " / " << median(s.ranks) << " / "
+                << most(s.ranks) << " min/median/max)" << std::endl;
+    }
+  }
+
+  static std::string quoted(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+      if (c == '"' || c == '\\') out += '\\';
+      out += c;
+    }
+    return out + "\"";
+  }
+
+  static void write_summary(std::ostream& out, const std::vector<double>& v) {
+    out << "{\"min\": " << least(v) << ", \"median\": " << median(v)
+        << ", \"max\": " << most(v) << "}";
+  }
+
+  void write_json(const std::vector<phase_stats>& stats) const {
+    std::ofstream out(options.json);
+    out.precision(9);
+    out << "{\n  \"benchmark\": " << quoted(benchmark)
+        << ",\n  \"graph\": " << quoted(graph)
+        << ",\n  \"ranks\": " << upcxx::rank_n()
+        << ",\n  \"warmup\": " << options.warmup
+        << ",\n  \"repetitions\": " << options.repetitions
+        << ",\n  \"phases\": {";
+    for (size_t p = 0; p < stats.size(); ++p) {
+      const phase_stats& s = stats[p];
+      out << (p ? ",\n" : "\n") << "    " << quoted(s.name)
+          << ": {\n      \"wall\": ";
+      write_summary(out, s.wall);
+      out << ",\n      \"samples\": [";
+      for (size_t i = 0; i < s.wall.size(); ++i) {
+        out << (i ? ", " : "") << s.wall[i];
+      }
+      out << "],\n      \"ranks\": ";
+      write_summary(out, s.ranks);
+      out << "\n    }";
+    }
+    out << "\n  },\n  \"metrics\": {";
+    size_t m = 0;
+    for (const auto& entry : metrics) {
+      out << (m++ ? ",\n" : "\n") << "    " << quoted(entry.first) << ": "
+          << entry.second;
+    }
+    out << "\n  }\n}\n";
+  }
+
+  void append_dat(const std::vector<phase_stats>& stats) const {
+    const bool    fresh = !std::ifstream(options.dat).good();
+    std::ofstream out(options.dat, std::ios::app);
+    if (fresh) {
+      out << "# Date";
+      for (const phase_stats& s : stats) out << '\t' << perfkey(s.name);
+      out << '\n';
+    }
+    char              date[16];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%m/%d/%y", std::localtime(&now));
+    out << date;
+    for (const phase_stats& s : stats) out << '\t' << median(s.wall);
+    out << '\n';
+  }
+
+  const std::string                             benchmark;
+  const std::string                             graph;
+  const benchmark_options                       options;
+  int                                           pass = 0;
+  std::string                                   running;
+  std::chrono::steady_clock::time_point         started;
+  double                                        phase_start_us = 0;
+  // phases in the order they were first timed, and their timed samples
+  std::vector<std::string>                      phases;
+  std::map<std::string, std::vector<double>>    samples;
+  std::map<std::string, double>                 last;
+  std::map<std::string, double>                 metrics;
+};
@@ -0,0 +1,378 @@
+/*Authors: Marcin Zalewski / Jesun Sahariar Firoz*/
+
+// Multi-source BFS: loads the graph once and runs the traversals from a list
+// of sources in batches of 64 * Words, one bit per source. Every vertex
+// keeps Words-word masks of the sources that have seen it and of those whose
+// frontier it is in, so one pass over an adjacency list advances every
+// traversal of the batch at once (Then et al., "The More the Merrier").
+//
+// Levels are synchronous. A rank ORs the frontier mask of each of its
+// frontier vertices into the next-frontier mask of every neighbor: directly
+// for its own neighbors, and through (offset, mask) updates aggregated per
+// owner rank and sent as one upcxx::rpc of up to batchUpdates updates for
+// the others.
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "benchmark_harness.hpp"
+#include "csr_loader.hpp"
+#include "flow_control.hpp"
+
+std::string edgelistFile = "";
+// Distribution of the vertices over ranks: cyclic, block or edge-block
+std::string partition = "cyclic";
+// comma-separated sources, or a file with one source per line
+std::string sourceList = "";
+std::string sourceFile = "";
+// Sources per batch: 64, 128, 256 or 512
+size_t batchWidth = 64;
+// Updates aggregated per destination rank, and cap on outstanding RPCs
+size_t batchUpdates = 4096;
+size_t maxInFlight  = 64;
+// When set, every rank writes "source vertex depth" lines for its vertices
+// to <depthsPrefix>.<rank>
+std::string depthsPrefix = "";
+// Warmup and timed repetitions, and where to write their times
+benchmark_options benchmarkOptions;
+
+// One bit per source of a batch. The word loops are left to the compiler,
+// which turns the 256- and 512-bit masks into SIMD operations.
+template <size_t Words>
+struct source_mask {
+  uint64_t w[Words];
+
+  static source_mask none() {
+    source_mask m;
+    std::fill(m.w, m.w + Words, 0);
+    return m;
+  }
+  bool any() const {
+    uint64_t acc = 0;
+    for (size_t i = 0; i < Words; ++i) acc |= w[i];
+    return acc != 0;
+  }
+  source_mask& operator|=(const source_mask& o) {
+    for (size_t i = 0; i < Words; ++i) w[i] |= o.w[i];
+    return *this;
+  }
+  // Bits of this mask that are not in o.
+  source_mask minus(const source_mask& o) const {
+    source_mask m;
+    for (size_t i = 0; i < Words; ++i) m.w[i] = w[i] & ~o.w[i];
+    return m;
+  }
+  void set(size_t bit) { w[bit / 64] |= uint64_t{1} << (bit % 64); }
+  // Calls f(bit) for every set bit.
+  template <typename F>
+  void for_each(F&& f) const {
+    for (size_t i = 0; i < Words; ++i) {
+      for (uint64_t word = w[i]; word; word &= word - 1) {
+        f(i * 64 + __builtin_ctzll(word));
+      }
+    }
+  }
+};
+
+template <typename Id, size_t Words>
+struct mask_update {
+  Id                 offset;    // local index of the target on its owner
+  source_mask<Words> mask;
+};
+
+std::vector<uint64_t> read_sources() {
+  std::vector<uint64_t> sources;
+  if (!sourceFile.empty()) {
+    std::ifstream in(sourceFile);
+    if (!in) throw std::runtime_error("Cannot open source file " + sourceFile);
+    uint64_t s;
+    while (in >> s) sources.push_back(s);
+  }
+  std::stringstream list(sourceList);
+  std::string       s;
+  while (std::getline(list, s, ',')) {
+    if (!s.empty()) sources.push_back(std::stoull(s, nullptr, 0));
+  }
+  return sources;
+}
+
+// Per-source results, summed over ranks.
+struct source_summary {
+  uint64_t reached   = 0;
+  uint64_t distances = 0;
+  uint64_t depth     = 0;
+};
+
+// Runs one batch of at most 64 * Words sources and adds their results to
+// summary (indexed by position in the batch).
+template <typename Id, size_t Words>
+class batched_bfs {
+public:
+  using mask   = source_mask<Words>;
+  using update = mask_update<Id, Words>;
+
+  // Collective: every rank constructs it at the same point.
+  explicit batched_bfs(const distributed_csr<Id>& graph)
+      : graph(graph),
+        seen(graph.num_vertices_per_rank),
+        frontier(graph.num_vertices_per_rank),
+        next(graph.num_vertices_per_rank),
+        self(this),
+        batches(upcxx::rank_n()) {}
+
+  void run(const uint64_t* sources, size_t count,
+           std::vector<source_summary>& summary, std::ostream* depths) {
+    std::fill(seen.begin(), seen.end(), mask::none());
+    std::fill(frontier.begin(), frontier.end(), mask::none());
+    std::fill(next.begin(), next.end(), mask::none());
+    for (size_t b = 0; b < count; ++b) {
+      if (vertex_id_to_rank(sources[b]) != upcxx::rank_me()) continue;
+      const uint64_t index = vertex_id_to_offset(sources[b]);
+      frontier[index].set(b);
+      seen[index].set(b);
+      ++summary[b].reached;
+      if (depths) *depths << sources[b] << ' ' << sources[b] << " 0\n";
+    }
+
+    for (uint64_t level = 1;; ++level) {
+      expand();
+      // every update of this level has been applied
+      upcxx::barrier();
+
+      uint64_t active = 0;
+      for (uint64_t i = 0; i < graph.num_vertices_per_rank; ++i) {
+        frontier[i] = next[i].minus(seen[i]);
+        next[i]     = mask::none();
+        if (!frontier[i].any()) continue;
+        ++active;
+        seen[i] |= frontier[i];
+        frontier[i].for_each([&](size_t b) {
+          ++summary[b].reached;
+          summary[b].distances += level;
+          summary[b].depth = level;
+          if (depths) {
+            *depths << sources[b] << ' ' << index_to_vertex_id(i) << ' '
+                    << level << '\n';
+          }
+        });
+      }
+      if (upcxx::reduce_all(active, [](uint64_t a, uint64_t b) {
+            return a + b;
+          }).wait() == 0) {
+        break;
+      }
+    }
+  }
+
+  // Updates sent to other ranks, and RPCs carrying them.
+  uint64_t updates_sent() const { return sent_updates; }
+  uint64_t batches_sent() const { return sent_batches; }
+
+private:
+  void expand() {
+    inflight_window window(maxInFlight);
+    for (uint64_t i = 0; i < graph.num_vertices_per_rank; ++i) {
+      if (!frontier[i].any()) continue;
+      const auto& row = graph.local(i);
+      const Id*   adj = row.p.local();
+      for (uint64_t j = 0; j < row.n; ++j) {
+        const upcxx::intrank_t rank = vertex_id_to_rank(adj[j]);
+        if (rank == upcxx::rank_me()) {
+          next[vertex_id_to_offset(adj[j])] |= frontier[i];
+        } else {
+          batches[rank].push_back(
+              update{static_cast<Id>(vertex_id_to_offset(adj[j])),
+                     frontier[i]});
+          if (batches[rank].size() >= batchUpdates) send(rank, window);
+        }
+      }
+      if (i % 1024 == 0) upcxx::progress();
+    }
+    for (upcxx::intrank_t r = 0; r < upcxx::rank_n(); ++r) {
+      if (!batches[r].empty()) send(r, window);
+    }
+    window.drain();
+  }
+
+  void send(upcxx::intrank_t rank, inflight_window& window) {
+    std::vector<update>& batch = batches[rank];
+    ++sent_batches;
+    sent_updates += batch.size();
+    note_rpc(rank, batch.size() * sizeof(update));
+    window.track(upcxx::rpc(
+        rank,
+        [](upcxx::dist_object<batched_bfs*>& owner, upcxx::view<update> in) {
+          for (const auto& u : in) (*owner)->next[u.offset] |= u.mask;
+        },
+        self, upcxx::make_view(batch.begin(), batch.end())));
+    batch.clear();
+  }
+
+  const distributed_csr<Id>&       graph;
+  std::vector<mask>                seen, frontier, next;
+  upcxx::dist_object<batched_bfs*> self;
+  std::vector<std::vector<update>> batches;
+  uint64_t                         sent_updates = 0;
+  uint64_t                         sent_batches = 0;
+};
+
+template <typename Id, size_t Words>
+void run_batches(const distributed_csr<Id>&   graph,
+                 const std::vector<uint64_t>& sources,
+                 benchmark_harness&           harness) {
+  const size_t  width = 64 * Words;
+  std::ofstream depths_file;
+  std::ostream* depths = nullptr;
+  if (!depthsPrefix.empty() && harness.last_repetition()) {
+    depths_file.open(depthsPrefix + "." + std::to_string(upcxx::rank_me()));
+    depths = &depths_file;
+  }
+  batched_bfs<Id, Words>      bfs(graph);
+  std::vector<source_summary> summary(sources.size());
+
+  harness.start("compute");
+  for (size_t first = 0; first < sources.size(); first += width) {
+    const size_t count = std::min(width, sources.size() - first);
+    std::vector<source_summary> batch(count);
+    bfs.run(&sources[first], count, batch, depths);
+    std::copy(batch.begin(), batch.end(), summary.begin() + first);
+  }
+
+  harness.stop();
+
+  harness.start("reduce");
+  // reached and distances add up over ranks, depths take the maximum
+  std::vector<uint64_t> sums(2 * sources.size()), depth(sources.size());
+  for (size_t s = 0; s < sources.size(); ++s) {
+    sums[2 * s]     = summary[s].reached;
+    sums[2 * s + 1] = summary[s].distances;
+    depth[s]        = summary[s].depth;
+  }
+  std::vector<uint64_t> total_sums(sums.size()), max_depth(depth.size());
+  upcxx::reduce_one(sums.data(), total_sums.data(), sums.size(),
+                    [](uint64_t a, uint64_t b) { return a + b; }, 0)
+      .wait();
+  upcxx::reduce_one(depth.data(), max_depth.data(), depth.size(),
+                    [](uint64_t a, uint64_t b) { return std::max(a, b); }, 0)
+      .wait();
+  const uint64_t local[2] = {bfs.updates_sent(), bfs.batches_sent()};
+  uint64_t       total[2] = {0, 0};
+  upcxx::reduce_one(local, total, 2,
+                    [](uint64_t a, uint64_t b) { return a + b; }, 0)
+      .wait();
+  harness.stop();
+  if (!harness.last_repetition()) return;
+  if (upcxx::rank_me() == 0) {
+    std::cout << "Total time " << 1000 * harness.seconds("compute")
+              << " ms for " << sources.size() << " sources in batches of "
+              << width << "." << std::endl;
+    harness.metric("sources", sources.size());
+    std::cout << "source reached distance_sum depth closeness" << std::endl;
+    for (size_t s = 0; s < sources.size(); ++s) {
+      const uint64_t reached   = total_sums[2 * s],
+                     distances = total_sums[2 * s + 1];
+      std::cout << sources[s] << ' ' << reached << ' ' << distances << ' '
+                << max_depth[s] << ' '
+                << (distances > 0 ? double(reached - 1) / distances : 0.0)
+                << std::endl;
+    }
+    std::cout << "Updates sent: " << total[0] << " in " << total[1]
+              << " RPCs" << std::endl;
+  }
+}
+
+template <typename Id>
+void bfs_all(const std::vector<uint64_t>& sources) {
+  if (batchWidth != 64 && batchWidth != 128 && batchWidth != 256 &&
+      batchWidth != 512) {
+    throw std::runtime_error("Batch width must be 64, 128, 256 or 512");
+  }
+  benchmark_harness harness("bfs_batched", edgelistFile, benchmarkOptions);
+  harness.start("load");
+  distributed_csr<Id> graph;
+  readBinaryFormat(edgelistFile, graph, csr_orientation::symmetric,
+                   parse_partition_kind(partition));
+  harness.stop();
+  for (uint64_t s : sources) {
+    if (s >= graph.num_vertices) {
+      throw std::runtime_error("Source " + std::to_string(s) +
+                               " is not a vertex of the graph");
+    }
+  }
+  while (harness.next_repetition()) {
+    switch (batchWidth) {
+      case 64: run_batches<Id, 1>(graph, sources, harness); break;
+      case 128: run_batches<Id, 2>(graph, sources, harness); break;
+      case 256: run_batches<Id, 4>(graph, sources, harness); break;
+      default: run_batches<Id, 8>(graph, sources, harness); break;
+    }
+  }
+  harness.report();
+}
+
+int main(int argc, char* argv[]) {
+  upcxx::init();
+
+  int argIndex = 1;
+  while (argIndex < argc) {
+    std::string arg(argv[argIndex]);
+    if (parse_benchmark_option(argv, argIndex, benchmarkOptions)) continue;
+    if (arg == "--edgelistfile") {
+      ++argIndex;
+      edgelistFile = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--partition") {
+      ++argIndex;
+      partition = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--sources") {
+      ++argIndex;
+      sourceList = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--sources-file") {
+      ++argIndex;
+      sourceFile = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--width") {
+      ++argIndex;
+      batchWidth = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--batch") {
+      ++argIndex;
+      batchUpdates = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--max-inflight") {
+      ++argIndex;
+      maxInFlight = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--depths") {
+      ++argIndex;
+      depthsPrefix = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+  }
+  const std::vector<uint64_t> sources = read_sources();
+  if (use_32bit_ids(edgelistFile)) {
+    bfs_all<uint32_t>(sources);
+  } else {
+    bfs_all<uint64_t>(sources);
+  }
+
+  upcxx::finalize();
+  return 0;
+}
@@ -10,7 +10,6 @@
 #include <numeric>
 #include <regex>
 #include <sstream>
-#include <sys/time.h>
 #include <utility>
 #include <vector>
 
@@ -23,6 +22,14 @@
 #include <upcxx/rput.hpp>
 #include <upcxx/upcxx.hpp>
 
+#include "benchmark_harness.hpp"
+#include "csr_loader.hpp"
+#include "delegates.hpp"
+#include "flow_control.hpp"
+#include "frontier_bitmap.hpp"
+#include "frontier_exchange.hpp"
+#include "instrumentation.hpp"
+
 #include <boost/asio.hpp>
 #include <boost/dynamic_bitset.hpp>
 
@@ -43,166 +50,80 @@ typedef uint64_t           IndexType;
 using element                     = std::tuple<ve_type, ve_type>;
 using edge_list                   = std::vector<std::tuple<ve_type, ve_type>>;
 std::string edgelistFile          = "";
-uint64_t    num_vertices          = 0;
-uint64_t    num_vertices_per_rank = 0;
-
-// retain a per-destination queue for current and next iteration
-std::vector<std::vector<std::pair<uint64_t, uint64_t>,
-                        upcxxc::allocator<std::pair<uint64_t, uint64_t>>>>
-    nextFrontierQarr[2];
-// received buffer is never exported, so no need for current and next
-std::vector<std::pair<uint64_t, uint64_t>> received_buffer;
-
-double GetCurrentTime() {
-  static struct timeval  tv;
-  static struct timezone tz;
-  gettimeofday(&tv, &tz);
-  return tv.tv_sec + 1.e-6 * tv.tv_usec;
-}
-
-double TimeDifference(double& a, double& b) { return 1000 * (b - a); }
-
-double ElapsedMillis(double start, double stop) {
-  return TimeDifference(start, stop);
-}
-
-struct gptr_and_len {
-  upcxx::global_ptr<uint64_t> p;    // pointer to first element in adjacencies
-  int                         n;    // number of elements
+// Distribution of the vertices over ranks: cyclic, block or edge-block
+std::string partition = "cyclic";
+// Cap on outstanding frontier fetches
+size_t maxInFlight = 64;
+// top-down, bottom-up or optimizing; the optimizing mode turns bottom-up
+// once the frontier has more than 1/alpha of the unvisited edges and back
+// once it shrinks below 1/beta of the vertices.
+std::string direction = "top-down";
+double      alpha     = 14;
+double      beta      = 24;
+// Replicate the rows of vertices of at least this degree on every rank (0:
+// never), or once per node
+uint64_t delegateDegree   = 0;
+bool     delegatesPerNode = false;
+// Warmup and timed repetitions, and where to write their times
+benchmark_options benchmarkOptions;
+
+// encoded (vertex, parent) pairs sent to the owner of the vertices (see
+// frontier_exchange.hpp)
+using frontier_message = std::vector<uint8_t, upcxxc::allocator<uint8_t>>;
+
+// retain a per-destination message for current and next iteration
+std::vector<frontier_message> nextFrontierQarr[2];
+
+struct gptr_and_len_message {
+  upcxx::global_ptr<uint8_t> p;    // pointer to first byte of the message
+  uint64_t                   n;    // number of bytes
 };
 
-struct gptr_and_len_pair {
-  upcxx::global_ptr<std::pair<uint64_t, uint64_t>>
-      p;    // pointer to first element in destination buffer
-  int n;    // number of elements
+using BaseQType = std::vector<upcxx::global_ptr<gptr_and_len_message>>;
+
+// How a level finds the vertices of the next frontier.
+enum class bfs_direction {
+  // owners of frontier vertices send (neighbor, parent) pairs to the owners
+  // of the neighbors
+  top_down,
+  // unvisited vertices look for a parent in the replicated frontier bitmap
+  bottom_up,
+  // choose per level with Beamer's heuristic (alpha, beta)
+  optimizing
 };
 
-std::vector<upcxx::global_ptr<gptr_and_len>> bases;
-
-using BaseType = std::vector<upcxx::global_ptr<gptr_and_len>>;
-
-using BaseQType = std::vector<upcxx::global_ptr<gptr_and_len_pair>>;
-
-uint64_t index_to_vertex_id(size_t index) {
-  // muliply for rows, add for row offset
-  return index * upcxx::rank_n() + upcxx::rank_me();
-}
-
-size_t vertex_id_to_index(uint64_t vertex_id) {
-  // It's ok to round off, as every vertex in a row in cyclic dist. will have the same index on every rank
-  return vertex_id / upcxx::rank_n();
-}
-
-auto print_graph() {
-  // For each vertex
-  for (uint64_t i = 0; i < num_vertices_per_rank; i++) {
-    const auto vtx_ptr =
-        bases[upcxx::rank_me()].local()
-            [i];    // <--This gives the local ptr to the gbl ptr and length for a vtx
-    const auto adj_list_start = vtx_ptr.p.local();
-    const auto adj_list_len   = vtx_ptr.n;
-
-    auto current_vertex_id = index_to_vertex_id(i);
-
-    std::cout << "i = " << i << ", vertex id = " << current_vertex_id
-              << ", adjs: ";
-    // For each neighbor of the vertex, get the adjacency  list and do the set intersection.
-    for (auto j = 0; j < vtx_ptr.n; j++) {
-      auto neighbor = adj_list_start[j];
-      std::cout << neighbor << ", ";
-    }
-    std::cout << std::endl;
-  }
-}
-
-upcxx::intrank_t vertex_id_to_rank(uint64_t v_id) {
-  return v_id % upcxx::rank_n();
-}
-
-auto vertex_id_to_offset(uint64_t v_id) { return v_id / upcxx::rank_n(); }
-
-void init_adjs(std::istream& infile, BaseType& bases) {
-  infile.read(reinterpret_cast<char*>(&num_vertices), sizeof(num_vertices));
-  std::cout << num_vertices << std::endl;
-
-  bases.reserve(upcxx::rank_n());
-  num_vertices_per_rank =
-      (num_vertices + upcxx::rank_n() - 1 - upcxx::rank_me()) / upcxx::rank_n();
-  std::cout << "No of vertices per rank: " << num_vertices_per_rank
-            << std::endl;
-  bases[upcxx::rank_me()] =
-      upcxx::new_array<gptr_and_len>(num_vertices_per_rank);
-
-  for (int r = 0; r < upcxx::rank_n(); r++) {
-    bases[r] = upcxx::broadcast(bases[r], r).wait();
-  }
-
-  for (uint64_t i = upcxx::rank_me(); i < num_vertices; i += upcxx::rank_n()) {
-    gptr_and_len pn;
-    uint64_t     adj_indices[2];
-    const auto   index_seekg = 1 + i;
-    infile.seekg(index_seekg * sizeof(uint64_t), infile.beg);
-    infile.read(reinterpret_cast<char*>(adj_indices), 2 * sizeof(uint64_t));
-    auto cur_adj_len = adj_indices[1] - adj_indices[0];
-    pn.n             = cur_adj_len;
-    pn.p                      = upcxx::new_array<uint64_t>(cur_adj_len);
-    const auto adj_list_seekg = 2 + num_vertices + adj_indices[0];
-    infile.seekg(adj_list_seekg * sizeof(uint64_t), infile.beg);
-    infile.read(reinterpret_cast<char*>(pn.p.local()),
-                cur_adj_len * sizeof(uint64_t));
-    for (auto edg = 0; edg < cur_adj_len; edg++) {
-      std::cout << pn.p.local()[edg] << " ";
-    }
- 
-    const auto base_index                       = vertex_id_to_index(i);
-    bases[upcxx::rank_me()].local()[base_index] = pn;
-  }
+bfs_direction parse_bfs_direction(const std::string& direction) {
+  if (direction == "top-down") return bfs_direction::top_down;
+  if (direction == "bottom-up") return bfs_direction::bottom_up;
+  if (direction == "optimizing") return bfs_direction::optimizing;
+  throw std::runtime_error("Unknown BFS direction: " + direction);
 }
 
-void readBinaryFormat(const std::string& filename, BaseType& bases) {
-  std::ifstream inputFile;
-  inputFile.exceptions(std::ifstream::failbit);
-  try {
-    inputFile.open(filename);
-    init_adjs(inputFile, bases);
-    inputFile.close();
-  } catch (std::ios_base::failure& fail) {
-    std::cerr << "Something went wrong with reading the matrix from file "
-              << filename << std::endl;
-    throw fail;
-  }
-}
-
-int main(int argc, char* argv[]) {
-  upcxx::init();
-
-  boost::asio::io_service io_service;
-
-  std::string h = ip::host_name();
-  std::cout << "hostname: " << h << 'n';
-
-  int         argIndex = 1;
-  std::string arg_t(argv[argIndex]);
-  uint64_t    source = 0;
-  while (argIndex < argc) {
-    std::string arg(argv[argIndex]);
-    if (arg == "--edgelistfile") {
-      ++argIndex;
-      edgelistFile = std::string(argv[argIndex]);
-      ++argIndex;
-    }
-    if (arg == "--source") {
-      ++argIndex;
-      source = std::stoul(argv[argIndex], nullptr, 0);
-      ++argIndex;
-    }
-  }
-  readBinaryFormat(edgelistFile, bases);
-
-  upcxx::barrier();
-
-  boost::dynamic_bitset<> color_map(num_vertices_per_rank);
-  std::vector<uint64_t>   parent_map(num_vertices_per_rank);
+// Runs BFS from source on the loaded graph once, as one repetition.
+template <typename Id>
+void bfs_once(const distributed_csr<Id>& graph, const hub_delegates<Id>& hubs,
+              uint64_t source, benchmark_harness& harness) {
+  const bfs_direction strategy = parse_bfs_direction(direction);
+
+  boost::dynamic_bitset<> color_map(graph.num_vertices_per_rank);
+  std::vector<Id>         parent_map(graph.num_vertices_per_rank);
+
+  // Local indices of the vertices visited in the previous level, and of
+  // those visited in this one
+  std::vector<uint64_t> frontier, next_frontier;
+  // Degree sums of the next frontier and of the unvisited vertices
+  uint64_t next_frontier_edges = 0;
+  uint64_t unvisited_edges     = graph.num_local_edges;
+  auto     visit               = [&](uint64_t v_index, Id parent) {
+    dout << "Marking " << index_to_vertex_id(v_index) << " as visited. "
+         << std::endl;
+    const uint64_t degree = graph.local(v_index).n;
+    color_map.set(v_index);
+    parent_map[v_index] = parent;
+    next_frontier.push_back(v_index);
+    next_frontier_edges += degree;
+    unvisited_edges -= degree;
+  };
 
   auto level               = 0;
   auto current_queue_index = [&]() { return level % 2; };
@@ -214,23 +135,29 @@ int main(int argc, char* argv[]) {
   for (size_t i = 0; i < 2; ++i) {
     nextFrontierQarr[i].resize(upcxx::rank_n());
   }
-  // find the rank of the source
-  auto rank = vertex_id_to_rank(source);
-  // if I am the owner of the source
-  if (rank == upcxx::rank_me()) {
-    auto v_index = vertex_id_to_index(source);
-    // Set source's colormap to 1.
-    color_map.set(v_index);
-    parent_map[v_index] = source;    // source is its own parent
-    auto vtx_ptr        = bases[upcxx::rank_me()].local()[v_index];
-    auto adj_list_start = vtx_ptr.p.local();
-    auto adj_list_len   = vtx_ptr.n;
-    // For each neighbor of the vertex, put it in appropriate buffer
-    for (auto j = 0; j < vtx_ptr.n; j++) {
-      auto neighbor     = adj_list_start[j];
-      auto neighborRank = vertex_id_to_rank(neighbor);
-      nextFrontierQ()[neighborRank].push_back(std::make_pair(neighbor, source));
-    }
+  // Hubs are tracked on every rank: whether they are visited, which of them
+  // form the frontier, and the least parent proposed for them this level
+  // (none: no_parent). Every rank expands the frontier hubs from their
+  // delegates into the neighbors it owns, and candidates for hubs are agreed
+  // on by a reduction instead of being sent to the owner.
+  const uint64_t        no_parent = std::numeric_limits<uint64_t>::max();
+  std::vector<bool>     hub_visited(hubs.count());
+  std::vector<size_t>   hub_frontier, next_hub_frontier;
+  std::vector<uint64_t> hub_parent(hubs.count(), no_parent),
+      hub_reached(hubs.count());
+  uint64_t hub_candidates = 0, hub_expansions = 0, hub_reductions = 0;
+  auto     propose_hub    = [&](size_t k, uint64_t parent) {
+    ++hub_candidates;
+    if (!hub_visited[k]) hub_parent[k] = std::min(hub_parent[k], parent);
+  };
+
+  // if I am the owner of the source, it forms the first frontier
+  if (vertex_id_to_rank(source) == upcxx::rank_me()) {
+    visit(vertex_id_to_index(source), static_cast<Id>(source));
+  }
+  if (hubs.find(source) != hubs.npos) {
+    hub_visited[hubs.find(source)] = true;
+    next_hub_frontier.push_back(hubs.find(source));
   }
 
   BaseQType gpNextFrontierQarr[2];
@@ -242,31 +169,58 @@ int main(int argc, char* argv[]) {
   for (auto i = 0; i < 2; ++i) {
     gpNextFrontierQarr[i].resize(upcxx::rank_n());
     gpNextFrontierQarr[i][upcxx::rank_me()] =
-        upcxx::new_array<gptr_and_len_pair>(upcxx::rank_n());
+        upcxx::new_array<gptr_and_len_message>(upcxx::rank_n());
     for (int r = 0; r < upcxx::rank_n(); r++) {
       gpNextFrontierQarr[i][r] =
           upcxx::broadcast(gpNextFrontierQarr[i][r], r).wait();
     }
   }
+  frontier_bitmap     bitmap;
+  frontier_outbox<Id> outbox(graph.num_vertices);
+
+  // Sends (neighbor, parent) pairs for every edge of the frontier and visits
+  // the unvisited vertices among those received.
+  uint64_t message_bytes = 0;
+  auto     top_down_step = [&]() {
+    for (auto v_index : frontier) {
+      const Id vtx            = index_to_vertex_id(v_index);
+      auto     vtx_ptr        = graph.local(v_index);
+      auto     adj_list_start = vtx_ptr.p.local();
+      if (hubs.find(vtx) != hubs.npos) continue;    // expanded by every rank
+      // Queue each neighbor for its owner, unless it was sent before
+      for (uint64_t j = 0; j < vtx_ptr.n; j++) {
+        const size_t hub = hubs.find(adj_list_start[j]);
+        if (hub != hubs.npos) {
+          propose_hub(hub, vtx);
+        } else {
+          outbox.add(adj_list_start[j], vtx);
+        }
+      }
+    }
+    // Expand the frontier hubs into the neighbors owned here
+    for (size_t k : hub_frontier) {
+      const Id  vtx            = hubs.vertex(k);
+      const Id* adj_list_start = hubs.row(k);
+      for (size_t j = 0; j < hubs.degree(k); j++) {
+        const uint64_t neighbor = adj_list_start[j];
+        if (vertex_id_to_rank(neighbor) != upcxx::rank_me()) continue;
+        if (vertex_id_to_rank(vtx) != upcxx::rank_me()) ++hub_expansions;
+        const size_t hub = hubs.find(neighbor);
+        if (hub != hubs.npos) {
+          propose_hub(hub, vtx);
+        } else if (!color_map[vertex_id_to_offset(neighbor)]) {
+          visit(vertex_id_to_offset(neighbor), vtx);
+        }
+      }
+    }
 
-  double start{0};
-  double stop{0};
-  if (upcxx::rank_me() == 0) start = GetCurrentTime();
-
-  while (true) {
-    // for each rank
-    size_t localFrontierSize = 0;
     for (upcxx::intrank_t r = 0; r < upcxx::rank_n(); r++) {
-      // sort and remove duplicates
-      std::sort(nextFrontierQ()[r].begin(), nextFrontierQ()[r].end(),
-                [](auto& a, auto& b) { return a.first < b.first; });
-      std::unique(nextFrontierQ()[r].begin(), nextFrontierQ()[r].end(),
-                  [](auto& a, auto& b) { return a.first == b.first; });
-
-      // Now copy the neighbor list per rank to the dist obj
-      gptr_and_len_pair pn;
-      auto              destination_buffer_size = nextFrontierQ()[r].size();
-      pn.n                                      = destination_buffer_size;
+      // The message of this parity was last read two levels ago.
+      outbox.encode(r, nextFrontierQ()[r]);
+
+      // Now copy the message per rank to the dist obj
+      gptr_and_len_message pn;
+      pn.n = nextFrontierQ()[r].size();
       dout << "nextFrontierQ()[r].data() = " << nextFrontierQ()[r].data()
                 << ", r = " << r << std::endl;
       pn.p = upcxx::try_global_ptr(nextFrontierQ()[r].data());
@@ -277,100 +231,272 @@ int main(int argc, char* argv[]) {
         }
       }
       gpNextFrontierQ()[upcxx::rank_me()].local()[r] = pn;
-
-      // reduce local frontier sizes
-      localFrontierSize += nextFrontierQ()[r].size();
     }
-
-    // Do a reduction to check whether we have reached the end
-    //////////////////////////////////////////////////////////
-    size_t totalFrontierSize = 0;
-    auto done_reduction =
-        upcxx::reduce_all(&localFrontierSize, &totalFrontierSize, 1,
-                          [](size_t a, size_t b) { return a + b; });
-    done_reduction.wait();
- 
-    // zero out receive buffer
-    received_buffer.resize(0);
-    // the start of the conjoined future
-    upcxx::future<> fut_all = upcxx::make_future();
-
-    if (upcxx::rank_me() == 0) {
-      std::cout << "Level: " << level << " Size: " << totalFrontierSize
-                << std::endl;
-    }
-
-    if (totalFrontierSize == 0) break;
+    // every rank has published its queues
+    upcxx::barrier();
 
     // Get vertices targeted for me from each rank
+    inflight_window window(maxInFlight);
     for (upcxx::intrank_t r = 0; r < upcxx::rank_n(); r++) {
-      upcxx::future<> fut =
+      if (r != upcxx::rank_me()) note_one_sided(r, sizeof(gptr_and_len_message));
+      window.track(
           upcxx::rget(    // TODO: skip me
               gpNextFrontierQ()[r] + upcxx::rank_me())
-              .then([=](gptr_and_len_pair pn) {
-                std::vector<std::pair<uint64_t, uint64_t>> target_neighbor_list(
-                    pn.n);
-                return upcxx::rget(pn.p, target_neighbor_list.data(), pn.n)
-                    .then([=, target_neighbor_list =
-                                  std::move(target_neighbor_list)]() {
-                      received_buffer.insert(received_buffer.end(),
-                                             target_neighbor_list.begin(),
-                                             target_neighbor_list.end());
+              .then([&, r](gptr_and_len_message pn) {
+                if (r != upcxx::rank_me()) {
+                  message_bytes += pn.n;
+                  note_one_sided(r, pn.n);
+                }
+                std::vector<uint8_t> message(pn.n);
+                return upcxx::rget(pn.p, message.data(), pn.n)
+                    .then([&, message = std::move(message)]() {
+                      // Check whether each vertex has already been visited.
+                      decode_frontier_message<Id>(
+                          message.data(), message.size(),
+                          [&](uint64_t v_index, Id parent) {
+                            if (!color_map[v_index]) visit(v_index, parent);
+                          });
                     });
-              });
-      // conjoin the futures
-      fut_all = upcxx::when_all(fut_all, fut);
+              }));
     }
 
-    // wait for all the conjoined futures to complete
-    fut_all.wait();
-    dout << "fut_all" << std::endl;
+    // wait for all the outstanding rgets to complete
+    window.drain();
+    dout << "drained" << std::endl;
+  };
 
-    // Important: do not increment the level until rgets are finished or the rgets will work with the wrong level
-    level += 1;
+  // Replicates the frontier as a bitmap and lets every unvisited vertex
+  // adopt the first of its neighbors found in it.
+  auto bottom_up_step = [&]() {
+    bitmap.clear();
+    for (auto v_index : frontier) bitmap.set(v_index);
+    bitmap.exchange(maxInFlight);
+
+    for (uint64_t v_index = 0; v_index < graph.num_vertices_per_rank;
+         ++v_index) {
+      if (color_map[v_index]) continue;
+      auto vtx_ptr        = graph.local(v_index);
+      auto adj_list_start = vtx_ptr.p.local();
+      for (uint64_t j = 0; j < vtx_ptr.n; j++) {
+        if (bitmap.contains(adj_list_start[j])) {
+          visit(v_index, adj_list_start[j]);
+          break;
+        }
+      }
+    }
+  };
 
-    // After level is increased, we can clear the data from the previous level that is still in the queue
-    for (upcxx::intrank_t r = 0; r < upcxx::rank_n(); r++) {
-      nextFrontierQ()[r].resize(0);
+  // Agrees on the hubs visited in this level, whichever step found them:
+  // owners add the hubs they visited themselves, and the least proposed
+  // parent wins. The owner visits a hub if it has not done so yet.
+  auto sync_hubs = [&]() {
+    if (hubs.count() == 0) return;
+    for (size_t k = 0; k < hubs.count(); ++k) {
+      const uint64_t v = hubs.vertex(k);
+      if (hub_visited[k] || vertex_id_to_rank(v) != upcxx::rank_me()) continue;
+      if (color_map[vertex_id_to_offset(v)]) {
+        hub_parent[k] =
+            std::min<uint64_t>(hub_parent[k], parent_map[vertex_id_to_offset(v)]);
+      }
     }
+    upcxx::reduce_all(hub_parent.data(), hub_reached.data(), hubs.count(),
+                      [](uint64_t a, uint64_t b) { return std::min(a, b); })
+        .wait();
+    ++hub_reductions;
+    for (size_t k = 0; k < hubs.count(); ++k) {
+      hub_parent[k] = no_parent;
+      if (hub_visited[k] || hub_reached[k] == no_parent) continue;
+      hub_visited[k] = true;
+      next_hub_frontier.push_back(k);
+      const uint64_t v = hubs.vertex(k);
+      if (vertex_id_to_rank(v) == upcxx::rank_me() &&
+          !color_map[vertex_id_to_offset(v)]) {
+        visit(vertex_id_to_offset(v), static_cast<Id>(hub_reached[k]));
+      }
+    }
+  };
 
-    // At this point everyone should have the next frontier for the next iteration
-    // sort and remove duplicates
-    std::sort(received_buffer.begin(), received_buffer.end(),
-              [](auto& a, auto& b) { return a.first < b.first; });
-    std::unique(received_buffer.begin(), received_buffer.end(),
-                [](auto& a, auto& b) { return a.first == b.first; });
-
-    for (auto vertex_p : received_buffer) {
-      auto vtx    = vertex_p.first;
-      auto parent = vertex_p.second;
-      // Check whether the vertex has already been visited.
-      auto v_index = vertex_id_to_index(vtx);
-      if (color_map[v_index]) {    //Already visited
-        continue;
-      } else {    // Not visited yet
-        dout << "Marking " << vtx << " as visited. " << std::endl;
-        color_map.set(v_index);
-        parent_map[v_index] = parent;
-        // Put all its neighbors into the nextfrontier
-        auto vtx_ptr        = bases[upcxx::rank_me()].local()[v_index];
-        auto adj_list_start = vtx_ptr.p.local();
-        auto adj_list_len   = vtx_ptr.n;
-        // For each neighbor of the vertex, put it in appropriate buffer
-        for (auto j = 0; j < vtx_ptr.n; j++) {
-          auto neighbor     = adj_list_start[j];
-          auto neighborRank = vertex_id_to_rank(neighbor);
-          nextFrontierQ()[neighborRank].push_back(
-              std::make_pair(neighbor, vtx));
-        }
+  harness.start("compute");
+
+  bool     bottom_up          = strategy == bfs_direction::bottom_up;
+  uint64_t last_frontier_size = 0;
+  uint64_t visited_vertices   = 0;
+  while (true) {
+    frontier.swap(next_frontier);
+    next_frontier.clear();
+    hub_frontier.swap(next_hub_frontier);
+    next_hub_frontier.clear();
+    visited_vertices += frontier.size();
+    note_frontier(level, frontier.size());
+
+    // Do a reduction to check whether we have reached the end, and to
+    // gather the sizes that the direction is chosen from
+    //////////////////////////////////////////////////////////
+    const uint64_t local_sizes[3] = {frontier.size(), next_frontier_edges,
+                                     unvisited_edges};
+    uint64_t       sizes[3]       = {0, 0, 0};
+    next_frontier_edges           = 0;
+    auto done_reduction =
+        upcxx::reduce_all(local_sizes, sizes, 3,
+                          [](uint64_t a, uint64_t b) { return a + b; });
+    {
+      blocked_scope blocked;
+      done_reduction.wait();
+    }
+    const uint64_t frontier_size = sizes[0], frontier_edges = sizes[1],
+                   remaining_edges = sizes[2];
+
+    if (frontier_size == 0) break;
+
+    if (strategy == bfs_direction::optimizing) {
+      if (!bottom_up) {
+        // switch once the frontier has more edges to check than a fraction
+        // of the unvisited vertices
+        bottom_up = frontier_edges > remaining_edges / alpha;
+      } else {
+        // switch back once the frontier is shrinking and small
+        bottom_up = frontier_size >= last_frontier_size ||
+                    frontier_size > graph.num_vertices / beta;
       }
     }
+    last_frontier_size = frontier_size;
+
+    if (upcxx::rank_me() == 0 && harness.last_repetition()) {
+      std::cout << "Level: " << level << " Size: " << frontier_size
+                << " Direction: " << (bottom_up ? "bottom-up" : "top-down")
+                << std::endl;
+    }
+
+    {
+      trace_scope step(bottom_up ? "bottom-up level" : "top-down level");
+      if (bottom_up) {
+        bottom_up_step();
+      } else {
+        top_down_step();
+      }
+      sync_hubs();
+    }
+
+    level += 1;
+  }
+
+  harness.stop();
+  // every rank has read the published queues of the last level
+  for (auto i = 0; i < 2; ++i) {
+    upcxx::delete_array(gpNextFrontierQarr[i][upcxx::rank_me()]);
   }
 
+  harness.start("reduce");
+  const uint64_t local[8] = {visited_vertices,         message_bytes,
+                             bitmap.bytes_sent(),      outbox.candidates_queued(),
+                             outbox.targets_sent(),    outbox.sparse_count(),
+                             outbox.dense_count(),     hub_candidates};
+  uint64_t       total[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  upcxx::reduce_one(local, total, 8,
+                    [](uint64_t a, uint64_t b) { return a + b; }, 0)
+      .wait();
+  harness.stop();
+  if (!harness.last_repetition()) return;
   if (upcxx::rank_me() == 0) {
-    stop          = GetCurrentTime();
-    float elapsed = ElapsedMillis(start, stop);
-    std::cout << "Total time " << elapsed << " ms." << std::endl;
+    std::cout << "Total time " << 1000 * harness.seconds("compute") << " ms."
+              << std::endl;
+    harness.metric("visited", total[0]);
+    std::cout << "Visited " << total[0] << " vertices; " << total[1]
+              << " bytes of frontier messages and " << total[2]
+              << " bytes of frontier bitmaps sent" << std::endl;
+    std::cout << "Frontier messages: " << total[3] << " candidates, "
+              << total[4] << " sent after deduplication, " << total[5]
+              << " sparse and " << total[6] << " dense messages" << std::endl;
+  }
+  // Pairs a hub owner would otherwise have sent to the other ranks
+  report_delegate_stats(hubs, hub_expansions, hub_expansions * 2 * sizeof(Id));
+  if (upcxx::rank_me() == 0 && hubs.count() > 0) {
+    std::cout << "Hub candidates: " << total[7]
+              << " resolved by reduction instead of messages, "
+              << hub_reductions << " reductions of "
+              << hubs.count() * sizeof(uint64_t) << " bytes" << std::endl;
+  }
+}
+
+// Loads the graph with Id-wide vertex IDs and runs BFS from source.
+template <typename Id>
+void bfs(uint64_t source) {
+  benchmark_harness harness("bfs_rget", edgelistFile, benchmarkOptions);
+  harness.start("load");
+  distributed_csr<Id> graph;
+  readBinaryFormat(edgelistFile, graph, csr_orientation::symmetric,
+                   parse_partition_kind(partition));
+  hub_delegates<Id> hubs(edgelistFile, delegateDegree,
+                         csr_orientation::symmetric, delegatesPerNode);
+  harness.stop();
+
+  while (harness.next_repetition()) bfs_once(graph, hubs, source, harness);
+  harness.report();
+}
+
+int main(int argc, char* argv[]) {
+  upcxx::init();
+
+  boost::asio::io_service io_service;
+
+  std::string h = ip::host_name();
+  std::cout << "hostname: " << h << 'n';
+
+  int         argIndex = 1;
+  std::string arg_t(argv[argIndex]);
+  uint64_t    source = 0;
+  while (argIndex < argc) {
+    std::string arg(argv[argIndex]);
+    if (parse_benchmark_option(argv, argIndex, benchmarkOptions)) continue;
+    if (arg == "--edgelistfile") {
+      ++argIndex;
+      edgelistFile = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--partition") {
+      ++argIndex;
+      partition = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--source") {
+      ++argIndex;
+      source = std::stoul(argv[argIndex], nullptr, 0);
+      ++argIndex;
+    }
+    if (arg == "--max-inflight") {
+      ++argIndex;
+      maxInFlight = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--direction") {
+      ++argIndex;
+      direction = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--alpha") {
+      ++argIndex;
+      alpha = std::stod(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--beta") {
+      ++argIndex;
+      beta = std::stod(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--delegate-degree") {
+      ++argIndex;
+      delegateDegree = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--delegates-per-node") {
+      ++argIndex;
+      delegatesPerNode = true;
+    }
+  }
+  if (use_32bit_ids(edgelistFile)) {
+    bfs<uint32_t>(source);
+  } else {
+    bfs<uint64_t>(source);
   }
 
   // TODO: clean up after each barrier, empty the next frontier ds, received buffer ds etc.
@@ -0,0 +1,51 @@
+#!/bin/bash
+# Runs triangle_counting in pull, push and hybrid mode on every given graph
+# and prints one line per run: time, bytes pulled (rget) and bytes pushed (rpc).
+#
+#   compare_tc_modes.sh -n [processes] [-N nodes] [-t triangle_counting binary]
+#                       [-a "extra kernel arguments"] graph_csr.bin ...
+
+processes=1
+nodes=1
+binary=./triangle_counting
+extra=""
+
+while getopts ":n:N:t:a:" opt; do
+  case ${opt} in
+    n )
+      processes=$OPTARG
+      ;;
+    N )
+      nodes=$OPTARG
+      ;;
+    t )
+      binary=$OPTARG
+      ;;
+    a )
+      extra=$OPTARG
+      ;;
+    \? )
+      echo "Invalid option: $OPTARG" 1>&2
+      exit 1
+      ;;
+    : )
+      echo "Invalid option: $OPTARG requires an argument" 1>&2
+      exit 1
+      ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+printf "%-40s %-8s %12s %14s %14s %12s\n" graph mode "time (ms)" "bytes pulled" "bytes pushed" triangles
+for FILE in "$@"; do
+  for MODE in pull push hybrid; do
+    out=$(GASNET_PHYSMEM_NOPROBE=1 srun --cpu_bind=none -n ${processes} -N ${nodes} \
+          ${binary} --edgelistfile ${FILE} --mode ${MODE} ${extra} 2>&1)
+    triangles=$(echo "$out" | sed -n 's/.*Total no of triangles: \([0-9]*\) counted in.*/\1/p')
+    elapsed=$(echo "$out" | sed -n 's/.*counted in \([0-9.e+-]*\) ms.*/\1/p')
+    pulled=$(echo "$out" | sed -n 's/.* \([0-9]*\) bytes fetched.*/\1/p')
+    pushed=$(echo "$out" | sed -n 's/.* \([0-9]*\) bytes sent.*/\1/p')
+    printf "%-40s %-8s %12s %14s %14s %12s\n" "$(basename -- ${FILE})" ${MODE} \
+      "${elapsed:-failed}" "${pulled:--}" "${pushed:--}" "${triangles:--}"
+  done
+done
@@ -0,0 +1,110 @@
+// Read-only access to the CSR files written by the converters, independent
+// of UPC++ so that tools other than the distributed loader can use it.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "../converters/csr_compressed.hpp"
+#include "../converters/csr_format.hpp"
+#include "../converters/mapped_file.hpp"
+
+// Read-only view of a CSR file. The layout is detected from the file itself
+// (see ../converters/README.md): files with a csr_file_header are checked
+// against the size the header implies; legacy files start with |V| or
+// |V| |E| and are told apart by the size each reading implies.
+class csr_file {
+public:
+  explicit csr_file(const std::string& filename)
+      : file(filename, MADV_NORMAL) {
+    if (file.size() >= sizeof(csr_file_magic) && is_chgl_csr(file.begin())) {
+      parse_csr_file_header(file.begin(), file.size(), header);
+      n       = header.num_vertices;
+      offsets = words(csr_offsets_pos(header));
+      if (header.codec == uncompressed) {
+        adjacency = file.begin() + csr_payload_pos(header);
+      } else {
+        byte_offsets = words(csr_byte_offsets_pos(header));
+        payload      = reinterpret_cast<const uint8_t*>(file.begin()) +
+                  csr_payload_pos(header);
+      }
+    } else if (legacy_layout_fits(1)) {
+      init_legacy(1);
+    } else if (legacy_layout_fits(2)) {
+      init_legacy(2);
+    } else {
+      throw std::runtime_error("Unrecognized CSR file layout in " + filename);
+    }
+  }
+
+  uint64_t num_vertices() const { return n; }
+  uint64_t degree(uint64_t v) const { return offsets[v + 1] - offsets[v]; }
+  uint64_t num_edges() const { return offsets[n]; }
+  // Position of the adjacency list of v among all adjacency entries.
+  uint64_t edge_offset(uint64_t v) const { return offsets[v]; }
+
+  // Copies (or decodes) the adjacency list of v into out, converting the
+  // IDs if the file stores them with a different width than Id.
+  template <typename Id>
+  void read_row(uint64_t v, Id* out) const {
+    if (header.codec != uncompressed) {
+      decode_row(header.codec, payload + byte_offsets[v],
+                 byte_offsets[v + 1] - byte_offsets[v], degree(v), out);
+    } else if (header.id_bytes == sizeof(Id)) {
+      std::memcpy(out, adjacency + offsets[v] * sizeof(Id),
+                  degree(v) * sizeof(Id));
+    } else if (header.id_bytes == sizeof(uint32_t)) {
+      convert_row(reinterpret_cast<const uint32_t*>(adjacency), v, out);
+    } else {
+      convert_row(reinterpret_cast<const uint64_t*>(adjacency), v, out);
+    }
+  }
+
+private:
+  const uint64_t* words(uint64_t byte_pos) const {
+    return reinterpret_cast<const uint64_t*>(file.begin() + byte_pos);
+  }
+
+  // Whether the file is exactly |V|, [|E|,] offsets and adjacency when the
+  // legacy header holds header_words 8-byte words.
+  bool legacy_layout_fits(uint64_t header_words) const {
+    const uint64_t file_words = file.size() / sizeof(uint64_t);
+    if (file.size() % sizeof(uint64_t) != 0 || file_words < header_words + 1) {
+      return false;
+    }
+    const uint64_t v = words(0)[0];
+    if (v > file_words - header_words - 1) return false;
+    const uint64_t e = words(0)[header_words + v];
+    return e <= file_words && header_words + v + 1 + e == file_words;
+  }
+
+  void init_legacy(uint64_t header_words) {
+    n         = words(0)[0];
+    offsets   = words(header_words * sizeof(uint64_t));
+    adjacency = file.begin() + (header_words + n + 1) * sizeof(uint64_t);
+  }
+
+  template <typename Stored, typename Id>
+  void convert_row(const Stored* ids, uint64_t v, Id* out) const {
+    std::copy(ids + offsets[v], ids + offsets[v + 1], out);
+  }
+
+  mapped_file     file;
+  csr_file_header header = make_csr_file_header(uncompressed, 0, 0, 0,
+                                                sizeof(uint64_t));
+  uint64_t        n            = 0;
+  const uint64_t* offsets      = nullptr;
+  const char*     adjacency    = nullptr;
+  const uint64_t* byte_offsets = nullptr;
+  const uint8_t*  payload      = nullptr;
+};
+
+// Whether the graph in filename is loaded with 32-bit vertex IDs, which is the
+// case whenever every vertex ID fits.
+inline bool use_32bit_ids(const std::string& filename) {
+  return csr_id_bytes(csr_file(filename).num_vertices()) == sizeof(uint32_t);
+}
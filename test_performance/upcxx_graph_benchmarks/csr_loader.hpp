@@ -0,0 +1,249 @@
+// Shared CSR loader for the UPC++ benchmarks.
+//
+// The binary file is memory-mapped once per rank. Every rank sums the
+// degrees of the vertices it owns (see partition.hpp), allocates one
+// shared-segment array for all of their adjacencies and fills it with one
+// memcpy (or decode, for compressed files) per vertex straight from the
+// mapping, so loading issues no per-vertex seek or read system calls.
+//
+// Each rank's graph is a CSR of its own: the segment and a shared-segment
+// array of num_vertices_per_rank + 1 offsets into it. Every rank knows the
+// base pointers of all segments and offset arrays, so the list of a remote
+// vertex is found with one rget of its two offsets; no per-vertex
+// descriptors are stored.
+//
+// Graphs are templated on the type of the stored vertex IDs. The kernels
+// load a graph with 32-bit IDs whenever every vertex ID fits (see
+// use_32bit_ids), which halves the bytes of every intersection and rget,
+// whatever ID width the file itself uses.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "csr_file.hpp"
+#include "partition.hpp"
+
+// An adjacency list, as computed from its offsets.
+template <typename Id>
+struct gptr_and_len {
+  upcxx::global_ptr<Id> p;    // pointer to first element in adjacencies
+  uint64_t              n;    // number of elements
+};
+
+template <typename Id>
+struct distributed_csr {
+  uint64_t num_vertices          = 0;
+  uint64_t num_vertices_per_rank = 0;
+  uint64_t num_local_edges       = 0;
+  // segments[r] holds all adjacencies owned by rank r, in local index order,
+  // and offsets[r] the position of each list in it (plus the end)
+  std::vector<upcxx::global_ptr<Id>>       segments;
+  std::vector<upcxx::global_ptr<uint64_t>> offsets;
+  const uint64_t*                          local_offsets = nullptr;
+
+  gptr_and_len<Id> local(uint64_t index) const {
+    return row(upcxx::rank_me(), local_offsets[index],
+               local_offsets[index + 1]);
+  }
+
+  // List of rank's segment between offsets begin and end.
+  gptr_and_len<Id> row(upcxx::intrank_t rank, uint64_t begin,
+                       uint64_t end) const {
+    return {segments[rank] + begin, end - begin};
+  }
+};
+
+// Distribution of the loaded graph; set by init_adjs before anything else
+// asks for an owner.
+inline vertex_partition& current_partition() {
+  static vertex_partition partition;
+  return partition;
+}
+
+inline uint64_t index_to_vertex_id(size_t index) {
+  return current_partition().vertex(upcxx::rank_me(), index);
+}
+
+inline size_t vertex_id_to_index(uint64_t vertex_id) {
+  return current_partition().offset(vertex_id);
+}
+
+inline upcxx::intrank_t vertex_id_to_rank(uint64_t v_id) {
+  return current_partition().owner(v_id);
+}
+
+inline uint64_t vertex_id_to_offset(uint64_t v_id) {
+  return current_partition().offset(v_id);
+}
+
+// Number of the num_vertices vertices that rank r owns.
+inline uint64_t vertices_owned_by(uint64_t /* num_vertices */,
+                                  upcxx::intrank_t r) {
+  return current_partition().owned_by(r);
+}
+
+// Most vertices any rank owns.
+inline uint64_t max_vertices_owned() {
+  return current_partition().max_owned();
+}
+
+// Which part of every adjacency list is loaded.
+enum class csr_orientation {
+  // the full symmetric adjacency list
+  symmetric,
+  // only the neighbors that come later in (degree, vertex id) order, so that
+  // every undirected edge is stored once, at its lower-degree endpoint
+  degree_ordered
+};
+
+// Whether u comes before v in (degree, vertex id) order.
+inline bool precedes_in_degree_order(const csr_file& input, uint64_t u,
+                                     uint64_t v) {
+  const uint64_t du = input.degree(u), dv = input.degree(v);
+  return du < dv || (du == dv && u < v);
+}
+
+// Reads the adjacency list of v into row, keeping only the neighbors selected
+// by orientation, and returns their number.
+template <typename Id>
+size_t read_oriented_row(const csr_file& input, uint64_t v,
+                         csr_orientation orientation, std::vector<Id>& row) {
+  row.resize(input.degree(v));
+  input.read_row(v, row.data());
+  if (orientation == csr_orientation::degree_ordered) {
+    row.erase(std::remove_if(row.begin(), row.end(),
+                             [&](Id u) {
+                               return !precedes_in_degree_order(input, v, u);
+                             }),
+              row.end());
+  }
+  return row.size();
+}
+
+// Prints the vertices and edges of the most loaded rank relative to the
+// mean over ranks.
+template <typename Id>
+void report_partition_balance(const distributed_csr<Id>& graph) {
+  const uint64_t local[2] = {graph.num_vertices_per_rank,
+                             graph.num_local_edges};
+  uint64_t       total[2] = {0, 0};
+  uint64_t       most[2]  = {0, 0};
+  upcxx::reduce_one(local, total, 2,
+                    [](uint64_t a, uint64_t b) { return a + b; }, 0)
+      .wait();
+  upcxx::reduce_one(local, most, 2,
+                    [](uint64_t a, uint64_t b) { return std::max(a, b); }, 0)
+      .wait();
+  if (upcxx::rank_me() == 0) {
+    const double ranks = upcxx::rank_n();
+    std::cout << "Partition "
+              << partition_name(current_partition().scheme())
+              << ": max/mean vertices per rank "
+              << (total[0] > 0 ? most[0] * ranks / total[0] : 1.0)
+              << ", max/mean edges per rank "
+              << (total[1] > 0 ? most[1] * ranks / total[1] : 1.0)
+              << std::endl;
+  }
+}
+
+// Loads the vertices owned by this rank and exchanges the base pointers of
+// the segments and offset arrays.
+template <typename Id>
+void init_adjs(const csr_file& input, distributed_csr<Id>& graph,
+               csr_orientation orientation = csr_orientation::symmetric,
+               partition_kind  partition   = partition_kind::cyclic) {
+  if (partition == partition_kind::checkerboard) {
+    throw std::runtime_error(
+        "The kernels need whole adjacency lists at one owner; the 2d "
+        "partition is only evaluated by partition_report");
+  }
+  current_partition() = vertex_partition(partition, input, upcxx::rank_n());
+  graph.num_vertices = input.num_vertices();
+  std::cout << graph.num_vertices << std::endl;
+
+  graph.num_vertices_per_rank =
+      vertices_owned_by(graph.num_vertices, upcxx::rank_me());
+  std::cout << "No of vertices per rank: " << graph.num_vertices_per_rank
+            << std::endl;
+
+  // Oriented rows are filtered twice, once to size the segment and once to
+  // fill it, rather than buffering the whole filtered adjacency.
+  const upcxx::intrank_t me = upcxx::rank_me();
+  std::vector<Id>        row;
+  graph.offsets.resize(upcxx::rank_n());
+  graph.offsets[me] =
+      upcxx::new_array<uint64_t>(graph.num_vertices_per_rank + 1);
+  uint64_t* offsets     = graph.offsets[me].local();
+  graph.num_local_edges = 0;
+  for (uint64_t index = 0; index < graph.num_vertices_per_rank; ++index) {
+    const uint64_t i = index_to_vertex_id(index);
+    offsets[index]   = graph.num_local_edges;
+    graph.num_local_edges +=
+        orientation == csr_orientation::symmetric
+            ? input.degree(i)
+            : read_oriented_row(input, i, orientation, row);
+  }
+  offsets[graph.num_vertices_per_rank] = graph.num_local_edges;
+  graph.local_offsets                  = offsets;
+  graph.segments.resize(upcxx::rank_n());
+  graph.segments[me] = upcxx::new_array<Id>(graph.num_local_edges);
+  for (int r = 0; r < upcxx::rank_n(); r++) {
+    graph.segments[r] = upcxx::broadcast(graph.segments[r], r).wait();
+    graph.offsets[r]  = upcxx::broadcast(graph.offsets[r], r).wait();
+  }
+
+  Id* adjacencies = graph.segments[me].local();
+  for (uint64_t index = 0; index < graph.num_vertices_per_rank; ++index) {
+    const uint64_t i = index_to_vertex_id(index);
+    if (orientation == csr_orientation::symmetric) {
+      input.read_row(i, adjacencies + offsets[index]);
+    } else {
+      read_oriented_row(input, i, orientation, row);
+      std::copy(row.begin(), row.end(), adjacencies + offsets[index]);
+    }
+  }
+  report_partition_balance(graph);
+}
+
+template <typename Id>
+void readBinaryFormat(const std::string& filename, distributed_csr<Id>& graph,
+                      csr_orientation orientation = csr_orientation::symmetric,
+                      partition_kind  partition   = partition_kind::cyclic) {
+  try {
+    csr_file input(filename);
+    init_adjs(input, graph, orientation, partition);
+  } catch (std::exception& fail) {
+    std::cerr << "Something went wrong with reading the matrix from file "
+              << filename << ": " << fail.what() << std::endl;
+    throw;
+  }
+}
+
+template <typename Id>
+void print_graph(const distributed_csr<Id>& graph) {
+  // For each vertex
+  for (uint64_t i = 0; i < graph.num_vertices_per_rank; i++) {
+    const auto vtx_ptr =
+        graph.local(i);    // <--This gives the local ptr to the gbl ptr and length for a vtx
+    const auto adj_list_start = vtx_ptr.p.local();
+
+    auto current_vertex_id = index_to_vertex_id(i);
+
+    std::cout << "i = " << i << ", vertex id = " << current_vertex_id
+              << ", adjs: ";
+    for (uint64_t j = 0; j < vtx_ptr.n; j++) {
+      auto neighbor = adj_list_start[j];
+      std::cout << neighbor << ", ";
+    }
+    std::cout << std::endl;
+  }
+}
@@ -0,0 +1,127 @@
+// Read-only replicas (delegates) of the adjacency lists of hub vertices.
+//
+// Every vertex whose degree in the file is at least min_degree is a hub.
+// Each rank finds the hubs from the mapped offsets on its own, so no
+// communication is needed to agree on them, and copies their rows (in the
+// orientation the kernel loads) straight from the mapping. With per_node,
+// only the first rank of each node (upcxx::local_team) copies the rows, into
+// its shared segment, and the other ranks of the node read that copy in
+// place.
+//
+// A kernel asks find(v) before going to the owner of v; for a hub it gets
+// the row locally. Hubs are few, so membership is a bitmap over all
+// vertices and the position among the hubs a binary search.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "csr_loader.hpp"
+
+template <typename Id>
+class hub_delegates {
+public:
+  static const size_t npos = ~size_t{0};
+
+  // Collective. min_degree 0 disables the delegates.
+  hub_delegates(const std::string& filename, uint64_t min_degree,
+                csr_orientation orientation, bool per_node)
+      : threshold(min_degree), shared_per_node(per_node) {
+    if (min_degree == 0) return;
+    csr_file input(filename);
+    member.assign((input.num_vertices() + 63) / 64, 0);
+    offsets.push_back(0);
+    std::vector<Id> row;
+    for (uint64_t v = 0; v < input.num_vertices(); ++v) {
+      if (input.degree(v) < min_degree) continue;
+      member[v / 64] |= uint64_t{1} << (v % 64);
+      ids.push_back(v);
+      offsets.push_back(offsets.back() +
+                        read_oriented_row(input, v, orientation, row));
+    }
+
+    const bool copies = !per_node || upcxx::local_team().rank_me() == 0;
+    if (copies) {
+      storage = upcxx::new_array<Id>(offsets.back());
+      Id* out = storage.local();
+      for (size_t k = 0; k < ids.size(); ++k) {
+        read_oriented_row(input, ids[k], orientation, row);
+        std::copy(row.begin(), row.end(), out + offsets[k]);
+      }
+    }
+    if (per_node) {
+      shared = upcxx::broadcast(storage, 0, upcxx::local_team()).wait();
+    } else {
+      shared = storage;
+    }
+    rows = shared.local();
+  }
+  hub_delegates(const hub_delegates&) = delete;
+  hub_delegates& operator=(const hub_delegates&) = delete;
+  ~hub_delegates() {
+    // other ranks of the node may still read the node's copy
+    if (shared_per_node) upcxx::barrier(upcxx::local_team());
+    if (storage != nullptr) upcxx::delete_array(storage);
+  }
+
+  // Number of hubs.
+  size_t count() const { return ids.size(); }
+
+  // Position of v among the hubs, or npos if it is not a hub.
+  size_t find(uint64_t v) const {
+    if (ids.empty() || !((member[v / 64] >> (v % 64)) & 1)) return npos;
+    return std::lower_bound(ids.begin(), ids.end(), v) - ids.begin();
+  }
+
+  uint64_t  vertex(size_t k) const { return ids[k]; }
+  const Id* row(size_t k) const { return rows + offsets[k]; }
+  size_t    degree(size_t k) const { return offsets[k + 1] - offsets[k]; }
+
+  // Bytes this rank holds for the delegates: the membership bitmap, the hub
+  // IDs and offsets, and the rows if this rank made the copy.
+  uint64_t bytes() const {
+    return member.size() * sizeof(uint64_t) +
+           ids.size() * sizeof(uint64_t) +
+           offsets.size() * sizeof(uint64_t) +
+           (storage != nullptr ? offsets.back() * sizeof(Id) : 0);
+  }
+
+  uint64_t min_degree() const { return threshold; }
+
+private:
+  const uint64_t             threshold;
+  const bool                 shared_per_node;
+  std::vector<uint64_t>      member;
+  std::vector<uint64_t>      ids;
+  std::vector<uint64_t>      offsets;
+  // this rank's copy of the rows, if it made one, and the copy it reads
+  upcxx::global_ptr<Id>      storage;
+  upcxx::global_ptr<Id>      shared;
+  const Id*                  rows = nullptr;
+};
+
+// Prints the hubs, the bytes held for them summed over ranks, and the
+// lookups (and their list bytes) that were served from the delegates
+// instead of the owner.
+template <typename Id>
+void report_delegate_stats(const hub_delegates<Id>& hubs, uint64_t served,
+                           uint64_t served_bytes) {
+  const uint64_t local[3] = {hubs.bytes(), served, served_bytes};
+  uint64_t       total[3] = {0, 0, 0};
+  upcxx::reduce_one(local, total, 3,
+                    [](uint64_t a, uint64_t b) { return a + b; }, 0)
+      .wait();
+  if (upcxx::rank_me() == 0 && hubs.min_degree() > 0) {
+    std::cout << "Delegates: " << hubs.count() << " hubs of degree >= "
+              << hubs.min_degree() << ", " << total[0]
+              << " bytes replicated over all ranks, " << total[1]
+              << " lookups served locally (" << total[2]
+              << " bytes not transferred)" << std::endl;
+  }
+}
@@ -0,0 +1,154 @@
+// Flow control for the rget-based kernels.
+//
+// inflight_window bounds the number of outstanding asynchronous operations.
+// Each tracked future decrements a counter when it completes; once the cap
+// is reached, track() drives progress until half of the window has drained,
+// so that progress is polled in bursts rather than after every issue. This
+// replaces conjoining every future of a phase with upcxx::when_all, whose
+// chain grows with the number of operations and has to be walked on
+// completion.
+//
+// offset_blocks finds the adjacency lists of remote vertices a block at a
+// time: one rget brings block_length + 1 consecutive offsets of a rank
+// (see csr_loader.hpp), which delimit the lists of block_length vertices,
+// and every later request for a vertex of that block is served locally.
+// Blocks are kept for the lifetime of the object (8 bytes per remote vertex
+// at most), and concurrent requests for a block in flight share its fetch.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "csr_loader.hpp"
+#include "instrumentation.hpp"
+
+class inflight_window {
+public:
+  explicit inflight_window(size_t limit) : limit(std::max<size_t>(limit, 1)) {}
+  inflight_window(const inflight_window&) = delete;
+  inflight_window& operator=(const inflight_window&) = delete;
+  ~inflight_window() { drain(); }
+
+  // Counts f as outstanding until it is ready, first waiting for room in
+  // the window if it is full.
+  template <typename... T>
+  void track(const upcxx::future<T...>& f) {
+    if (outstanding >= limit) drain_to(limit / 2);
+    ++outstanding;
+    peak = std::max(peak, outstanding);
+    f.then([this](const T&...) { --outstanding; });
+  }
+
+  // Waits until no tracked operation is outstanding.
+  void drain() { drain_to(0); }
+
+  size_t in_flight() const { return outstanding; }
+  // Most operations outstanding at once so far.
+  size_t peak_in_flight() const { return peak; }
+
+private:
+  void drain_to(size_t target) {
+    if (outstanding <= target) return;
+    blocked_scope blocked;
+    while (outstanding > target) upcxx::progress();
+  }
+
+  const size_t limit;
+  size_t       outstanding = 0;
+  size_t       peak        = 0;
+};
+
+template <typename Id>
+class offset_blocks {
+public:
+  using block_ptr = std::shared_ptr<const std::vector<uint64_t>>;
+
+  offset_blocks(const distributed_csr<Id>& graph, size_t block_length)
+      : graph(graph), block_length(std::max<size_t>(block_length, 1)) {}
+
+  // The adjacency list of vertex_id, owned by any rank; local offsets are
+  // read in place.
+  upcxx::future<gptr_and_len<Id>> fetch(uint64_t vertex_id) {
+    const upcxx::intrank_t rank   = vertex_id_to_rank(vertex_id);
+    const uint64_t         offset = vertex_id_to_offset(vertex_id);
+    const uint64_t         block  = offset / block_length;
+    const size_t           index  = offset % block_length;
+    const uint64_t         key    = block * upcxx::rank_n() + rank;
+    if (rank == upcxx::rank_me()) return upcxx::make_future(graph.local(offset));
+
+    const distributed_csr<Id>& g = graph;
+    auto in_block = [&g, rank, index](block_ptr b) {
+      return g.row(rank, (*b)[index], (*b)[index + 1]);
+    };
+    auto found = blocks.find(key);
+    if (found != blocks.end() && found->second.data) {
+      return upcxx::make_future(in_block(found->second.data));
+    }
+    if (found == blocks.end()) {
+      const uint64_t first = block * block_length;
+      const size_t   count = std::min<uint64_t>(
+          block_length,
+          vertices_owned_by(graph.num_vertices, rank) - first);
+      auto data = std::make_shared<std::vector<uint64_t>>(count + 1);
+      ++fetched;
+      fetched_bytes += (count + 1) * sizeof(uint64_t);
+      note_one_sided(rank, (count + 1) * sizeof(uint64_t));
+      blocks[key];    // in flight from here on
+      upcxx::future<block_ptr> pending =
+          upcxx::rget(graph.offsets[rank] + first, data->data(), count + 1)
+              .then([this, key, data]() {
+                entry& e  = blocks[key];
+                e.data    = data;
+                e.pending = upcxx::future<block_ptr>();
+                return block_ptr(data);
+              });
+      // The fetch may already have completed.
+      entry& e = blocks[key];
+      if (!e.data) e.pending = pending;
+      return pending.then(in_block);
+    }
+    return found->second.pending.then(in_block);
+  }
+
+  // Sets list to the adjacency list of vertex_id if it is local or its block
+  // has arrived, and returns whether it did.
+  bool find(uint64_t vertex_id, gptr_and_len<Id>& list) const {
+    const upcxx::intrank_t rank   = vertex_id_to_rank(vertex_id);
+    const uint64_t         offset = vertex_id_to_offset(vertex_id);
+    if (rank == upcxx::rank_me()) {
+      list = graph.local(offset);
+      return true;
+    }
+    auto found = blocks.find(offset / block_length * upcxx::rank_n() + rank);
+    if (found == blocks.end() || !found->second.data) return false;
+    const std::vector<uint64_t>& b     = *found->second.data;
+    const size_t                 index = offset % block_length;
+    list = graph.row(rank, b[index], b[index + 1]);
+    return true;
+  }
+
+  // Number of block rgets issued.
+  uint64_t blocks_fetched() const { return fetched; }
+
+  // Bytes transferred by those rgets.
+  uint64_t bytes_fetched() const { return fetched_bytes; }
+
+private:
+  struct entry {
+    upcxx::future<block_ptr> pending;
+    // null while the block is in flight
+    block_ptr                data;
+  };
+
+  const distributed_csr<Id>&          graph;
+  const size_t                        block_length;
+  std::unordered_map<uint64_t, entry> blocks;
+  uint64_t                            fetched       = 0;
+  uint64_t                            fetched_bytes = 0;
+};
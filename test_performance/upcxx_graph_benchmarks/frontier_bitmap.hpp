@@ -0,0 +1,89 @@
+// Replicated frontier bitmap for bottom-up BFS steps.
+//
+// Every rank keeps a bitmap of the whole frontier in its shared segment,
+// laid out as one block of words per owner rank: bit i of block r is the
+// vertex of local index i on rank r (see csr_loader.hpp). A rank sets the
+// bits of its own frontier vertices in a private block and exchange() rputs
+// that block into the matching slot of every rank's bitmap, so that after
+// the exchange every membership test is a local bit probe.
+//
+// The exchange is followed by a barrier. The kernel must synchronize all
+// ranks again (it does so with the reduction at the top of every level)
+// before the next exchange, so that no rank overwrites a bitmap another rank
+// is still probing.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "csr_loader.hpp"
+#include "flow_control.hpp"
+#include "instrumentation.hpp"
+
+class frontier_bitmap {
+public:
+  // Collective: every rank constructs its bitmap at the same point, after
+  // the graph is loaded.
+  frontier_bitmap()
+      : words_per_rank((max_vertices_owned() + 63) / 64),
+        own(words_per_rank, 0),
+        bitmaps(upcxx::rank_n()) {
+    bitmaps[upcxx::rank_me()] =
+        upcxx::new_array<uint64_t>(words_per_rank * upcxx::rank_n());
+    for (int r = 0; r < upcxx::rank_n(); r++) {
+      bitmaps[r] = upcxx::broadcast(bitmaps[r], r).wait();
+    }
+  }
+  frontier_bitmap(const frontier_bitmap&) = delete;
+  frontier_bitmap& operator=(const frontier_bitmap&) = delete;
+  ~frontier_bitmap() { upcxx::delete_array(bitmaps[upcxx::rank_me()]); }
+
+  // Empties this rank's part of the next frontier.
+  void clear() { std::fill(own.begin(), own.end(), 0); }
+
+  // Adds the vertex of local index to this rank's part of the next frontier.
+  void set(uint64_t index) { own[index / 64] |= uint64_t{1} << (index % 64); }
+
+  // Collective: publishes this rank's part to every rank and waits until the
+  // parts of all ranks have arrived.
+  void exchange(size_t max_in_flight) {
+    inflight_window window(max_in_flight);
+    for (int r = 0; r < upcxx::rank_n(); r++) {
+      const upcxx::global_ptr<uint64_t> slot =
+          bitmaps[r] + upcxx::rank_me() * words_per_rank;
+      if (r == upcxx::rank_me()) {
+        std::copy(own.begin(), own.end(), slot.local());
+      } else {
+        window.track(upcxx::rput(own.data(), slot, words_per_rank));
+        sent_bytes += words_per_rank * sizeof(uint64_t);
+        note_one_sided(r, words_per_rank * sizeof(uint64_t));
+      }
+    }
+    window.drain();
+    blocked_scope blocked;
+    upcxx::barrier();
+  }
+
+  // Whether vertex_id, owned by any rank, is in the exchanged frontier.
+  bool contains(uint64_t vertex_id) const {
+    const uint64_t offset = vertex_id_to_offset(vertex_id);
+    const uint64_t word =
+        bitmaps[upcxx::rank_me()].local()[vertex_id_to_rank(vertex_id) *
+                                              words_per_rank +
+                                          offset / 64];
+    return (word >> (offset % 64)) & 1;
+  }
+
+  // Bytes this rank has rput to other ranks.
+  uint64_t bytes_sent() const { return sent_bytes; }
+
+private:
+  const uint64_t                           words_per_rank;
+  std::vector<uint64_t>                    own;
+  std::vector<upcxx::global_ptr<uint64_t>> bitmaps;
+  uint64_t                                 sent_bytes = 0;
+};
@@ -0,0 +1,178 @@
+// Deduplicated, compressed frontier messages for top-down BFS steps.
+//
+// frontier_outbox collects the (neighbor, parent) candidates of a level per
+// owner rank of the neighbor. It keeps one bit per vertex of every rank
+// recording whether the vertex has been sent to its owner before, in this
+// level or an earlier one; later candidates for it are dropped on the spot,
+// so no duplicate is ever sent and no sort is needed to find them.
+//
+// The candidates for a rank are then encoded as one message:
+//
+//   frontier_message_header  - encoding and number of targets k
+//   parents                  - k IDs, in increasing target order
+//   targets                  - sparse: k varint gaps of the sorted local
+//                              indices (see ../converters/csr_compressed.hpp)
+//                              dense:  a bitmap of the rank's vertices
+//
+// The encoding is chosen per message from the density of the targets
+// among the vertices of the destination: a bitmap costs a bit per vertex
+// the rank owns, the gaps about a byte per 7 bits of the average gap.
+// Dense messages are built with a popcount prefix instead of a sort.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "../converters/csr_compressed.hpp"
+#include "csr_loader.hpp"
+
+enum frontier_encoding : uint32_t { sparse_gaps = 0, dense_bitmap = 1 };
+
+struct frontier_message_header {
+  uint32_t encoding;
+  uint32_t reserved;
+  uint64_t count;
+};
+
+// Bytes of a varint holding gap.
+inline size_t varint_bytes(uint64_t gap) {
+  size_t bytes = 1;
+  while (gap >= 0x80) {
+    gap >>= 7;
+    ++bytes;
+  }
+  return bytes;
+}
+
+template <typename Id>
+class frontier_outbox {
+public:
+  explicit frontier_outbox(uint64_t num_vertices)
+      : num_vertices(num_vertices),
+        sent(upcxx::rank_n()),
+        pending(upcxx::rank_n()) {
+    for (int r = 0; r < upcxx::rank_n(); r++) {
+      sent[r].assign((vertices_owned_by(num_vertices, r) + 63) / 64, 0);
+    }
+  }
+
+  // Queues parent as the parent of neighbor, unless neighbor has been
+  // queued before.
+  void add(uint64_t neighbor, Id parent) {
+    const upcxx::intrank_t rank   = vertex_id_to_rank(neighbor);
+    const uint64_t         offset = vertex_id_to_offset(neighbor);
+    uint64_t&              word   = sent[rank][offset / 64];
+    const uint64_t         bit    = uint64_t{1} << (offset % 64);
+    ++candidates;
+    if (word & bit) return;
+    word |= bit;
+    pending[rank].emplace_back(static_cast<Id>(offset), parent);
+  }
+
+  // Encodes the candidates queued for rank into message, replacing its
+  // contents, and empties the queue.
+  template <typename Buffer>
+  void encode(upcxx::intrank_t rank, Buffer& message) {
+    std::vector<std::pair<Id, Id>>& targets = pending[rank];
+    const uint64_t owned = vertices_owned_by(num_vertices, rank);
+    const uint64_t words = (owned + 63) / 64;
+    message.clear();
+    if (targets.empty()) return;
+
+    const uint64_t k = targets.size();
+    const bool     dense =
+        words * sizeof(uint64_t) < k * varint_bytes(owned / k);
+    frontier_message_header header = {dense ? dense_bitmap : sparse_gaps, 0,
+                                      k};
+    message.resize(sizeof(header) + k * sizeof(Id));
+    std::memcpy(&message[0], &header, sizeof(header));
+    Id* parents = reinterpret_cast<Id*>(&message[sizeof(header)]);
+
+    if (dense) {
+      std::vector<uint64_t> bitmap(words, 0);
+      for (const auto& t : targets) {
+        bitmap[t.first / 64] |= uint64_t{1} << (t.first % 64);
+      }
+      // rank of the first target of every word among all targets
+      std::vector<uint64_t> first(words);
+      uint64_t              seen = 0;
+      for (uint64_t w = 0; w < words; ++w) {
+        first[w] = seen;
+        seen += __builtin_popcountll(bitmap[w]);
+      }
+      for (const auto& t : targets) {
+        const uint64_t below =
+            bitmap[t.first / 64] & ((uint64_t{1} << (t.first % 64)) - 1);
+        parents[first[t.first / 64] + __builtin_popcountll(below)] = t.second;
+      }
+      const size_t pos = message.size();
+      message.resize(pos + words * sizeof(uint64_t));
+      std::memcpy(&message[pos], bitmap.data(), words * sizeof(uint64_t));
+      ++dense_messages;
+    } else {
+      std::sort(targets.begin(), targets.end());
+      std::vector<Id> offsets(k);
+      for (uint64_t i = 0; i < k; ++i) {
+        offsets[i] = targets[i].first;
+        parents[i] = targets[i].second;
+      }
+      encode_row_varint(offsets.data(), k, message);
+      ++sparse_messages;
+    }
+    sent_targets += k;
+    targets.clear();
+  }
+
+  // Candidates queued so far, and how many of them were sent.
+  uint64_t candidates_queued() const { return candidates; }
+  uint64_t targets_sent() const { return sent_targets; }
+  // Messages encoded with each encoding.
+  uint64_t sparse_count() const { return sparse_messages; }
+  uint64_t dense_count() const { return dense_messages; }
+
+private:
+  const uint64_t                              num_vertices;
+  std::vector<std::vector<uint64_t>>          sent;
+  std::vector<std::vector<std::pair<Id, Id>>> pending;
+  uint64_t                                    candidates      = 0;
+  uint64_t                                    sent_targets    = 0;
+  uint64_t                                    sparse_messages = 0;
+  uint64_t                                    dense_messages  = 0;
+};
+
+// Calls visit(local index, parent) for every target of a message encoded by
+// frontier_outbox::encode, in increasing index order.
+template <typename Id, typename Visit>
+void decode_frontier_message(const uint8_t* message, size_t bytes,
+                             Visit&& visit) {
+  if (bytes == 0) return;
+  frontier_message_header header;
+  std::memcpy(&header, message, sizeof(header));
+  std::vector<Id> parents(header.count);
+  std::memcpy(parents.data(), message + sizeof(header),
+              header.count * sizeof(Id));
+  const uint8_t* targets = message + sizeof(header) + header.count * sizeof(Id);
+
+  if (header.encoding == dense_bitmap) {
+    uint64_t next = 0;
+    for (size_t w = 0; targets + (w + 1) * sizeof(uint64_t) <= message + bytes;
+         ++w) {
+      uint64_t word;
+      std::memcpy(&word, targets + w * sizeof(uint64_t), sizeof(word));
+      while (word) {
+        visit(w * 64 + __builtin_ctzll(word), parents[next++]);
+        word &= word - 1;
+      }
+    }
+  } else {
+    std::vector<uint64_t> offsets(header.count);
+    decode_row_varint(targets, header.count, offsets.data());
+    for (uint64_t i = 0; i < header.count; ++i) visit(offsets[i], parents[i]);
+  }
+}
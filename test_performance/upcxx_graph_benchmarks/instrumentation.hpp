@@ -0,0 +1,339 @@
+// Per-rank communication and work counters for the UPC++ kernels.
+//
+// Compiled in with -DGRAPH_INSTRUMENT; otherwise every function below is an
+// empty inline and every scope an empty object, so the hooks in the kernels
+// cost nothing. When compiled in, each rank counts
+//
+//   one-sided operations (rget, rput) and their bytes, per target rank
+//   RPCs and their payload bytes, per target rank
+//   intersections and the elements they compared (na + nb per call)
+//   the local frontier size of every BFS level
+//   time blocked waiting for communication (blocked_scope)
+//   peak resident set size
+//
+// The counters are reset at the start of every repetition of the benchmark
+// harness, so they describe the last one. report_instrumentation() prints
+// the totals and the max/mean over ranks of each (imbalance), names the
+// rank that receives the most bytes (hot peer), and optionally writes the
+// rank x rank communication matrix as CSV and a Chrome trace (JSON, for
+// chrome://tracing or Perfetto) of the harness phases, BFS levels and
+// blocked intervals, with one process per rank. Trace times are relative
+// to the barrier that starts the load phase.
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include <upcxx/upcxx.hpp>
+
+#ifdef GRAPH_INSTRUMENT
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <sys/resource.h>
+
+struct trace_event {
+  std::string name;
+  double      start_us;
+  double      duration_us;
+};
+
+struct rank_counters {
+  std::vector<uint64_t>    one_sided_ops, one_sided_bytes;    // per target
+  std::vector<uint64_t>    rpcs, rpc_bytes;                   // per target
+  uint64_t                 intersections         = 0;
+  uint64_t                 intersection_elements = 0;
+  std::vector<uint64_t>    frontier;    // per level
+  double                   blocked_seconds = 0;
+  std::vector<trace_event> events;
+  std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+};
+
+// Events kept per rank; later ones are dropped.
+const size_t max_trace_events = 1 << 20;
+
+inline rank_counters& counters() {
+  static rank_counters c;
+  if (c.rpcs.empty()) {
+    c.one_sided_ops.assign(upcxx::rank_n(), 0);
+    c.one_sided_bytes.assign(upcxx::rank_n(), 0);
+    c.rpcs.assign(upcxx::rank_n(), 0);
+    c.rpc_bytes.assign(upcxx::rank_n(), 0);
+  }
+  return c;
+}
+
+inline double microseconds_since_epoch() {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - counters().epoch)
+      .count();
+}
+
+// Makes now time 0 of the trace; called right after a barrier.
+inline void set_trace_epoch() {
+  counters().epoch = std::chrono::steady_clock::now();
+}
+
+// Clears the counters (not the trace) for a new repetition.
+inline void reset_counters() {
+  rank_counters& c = counters();
+  std::fill(c.one_sided_ops.begin(), c.one_sided_ops.end(), 0);
+  std::fill(c.one_sided_bytes.begin(), c.one_sided_bytes.end(), 0);
+  std::fill(c.rpcs.begin(), c.rpcs.end(), 0);
+  std::fill(c.rpc_bytes.begin(), c.rpc_bytes.end(), 0);
+  c.intersections = c.intersection_elements = 0;
+  c.frontier.clear();
+  c.blocked_seconds = 0;
+}
+
+inline void note_one_sided(upcxx::intrank_t target, uint64_t bytes) {
+  ++counters().one_sided_ops[target];
+  counters().one_sided_bytes[target] += bytes;
+}
+
+inline void note_rpc(upcxx::intrank_t target, uint64_t bytes) {
+  ++counters().rpcs[target];
+  counters().rpc_bytes[target] += bytes;
+}
+
+inline void note_intersection(uint64_t na, uint64_t nb) {
+  ++counters().intersections;
+  counters().intersection_elements += na + nb;
+}
+
+inline void note_frontier(uint64_t level, uint64_t size) {
+  std::vector<uint64_t>& frontier = counters().frontier;
+  if (frontier.size() <= level) frontier.resize(level + 1, 0);
+  frontier[level] += size;
+}
+
+// Records an event named name that started at start_us and ends now.
+inline void note_trace_event(const std::string& name, double start_us) {
+  std::vector<trace_event>& events = counters().events;
+  if (events.size() >= max_trace_events) return;
+  events.push_back({name, start_us, microseconds_since_epoch() - start_us});
+}
+
+// Records its lifetime as a trace event named name, which must be a string
+// literal.
+class trace_scope {
+public:
+  explicit trace_scope(const char* name)
+      : name(name), start_us(microseconds_since_epoch()) {}
+  trace_scope(const trace_scope&) = delete;
+  trace_scope& operator=(const trace_scope&) = delete;
+  ~trace_scope() { note_trace_event(name, start_us); }
+
+private:
+  const char*  name;
+  const double start_us;
+};
+
+// Counts its lifetime as time blocked on communication.
+class blocked_scope {
+public:
+  blocked_scope() : start_us(microseconds_since_epoch()) {}
+  blocked_scope(const blocked_scope&) = delete;
+  blocked_scope& operator=(const blocked_scope&) = delete;
+  ~blocked_scope() {
+    counters().blocked_seconds += (microseconds_since_epoch() - start_us) / 1e6;
+    note_trace_event("blocked", start_us);
+  }
+
+private:
+  const double start_us;
+};
+
+// Sum, max and mean over ranks of value, on rank 0.
+struct rank_spread {
+  double sum = 0, max = 0, mean = 0;
+};
+
+inline rank_spread spread_over_ranks(double value) {
+  rank_spread s;
+  s.sum = upcxx::reduce_one(value, [](double a, double b) { return a + b; }, 0)
+              .wait();
+  s.max = upcxx::reduce_one(value,
+                            [](double a, double b) { return std::max(a, b); },
+                            0)
+              .wait();
+  s.mean = s.sum / upcxx::rank_n();
+  return s;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const rank_spread& s) {
+  return out << s.sum << " (max/mean per rank " << s.max << " / " << s.mean
+             << ")";
+}
+
+// Collective: prints the counters summed over ranks and writes the
+// communication matrix and the trace if files are given.
+inline void report_instrumentation(const std::string& matrix_file,
+                                   const std::string& trace_file) {
+  rank_counters&         c = counters();
+  const upcxx::intrank_t p = upcxx::rank_n(), me = upcxx::rank_me();
+
+  // four p x p matrices (one-sided ops and bytes, RPCs and bytes) indexed
+  // [kind][source][target]; this rank fills its row of each
+  std::vector<uint64_t> mine(4 * p * p, 0), matrix(4 * p * p, 0);
+  for (upcxx::intrank_t t = 0; t < p; ++t) {
+    mine[(0 * p + me) * p + t] = c.one_sided_ops[t];
+    mine[(1 * p + me) * p + t] = c.one_sided_bytes[t];
+    mine[(2 * p + me) * p + t] = c.rpcs[t];
+    mine[(3 * p + me) * p + t] = c.rpc_bytes[t];
+  }
+  upcxx::reduce_one(mine.data(), matrix.data(), mine.size(),
+                    [](uint64_t a, uint64_t b) { return a + b; }, 0)
+      .wait();
+
+  auto sum_of = [](const std::vector<uint64_t>& v) {
+    uint64_t s = 0;
+    for (uint64_t x : v) s += x;
+    return s;
+  };
+  const rank_spread one_sided_bytes =
+      spread_over_ranks(sum_of(c.one_sided_bytes));
+  const rank_spread rpc_bytes     = spread_over_ranks(sum_of(c.rpc_bytes));
+  const rank_spread elements      = spread_over_ranks(c.intersection_elements);
+  const rank_spread intersections = spread_over_ranks(c.intersections);
+  const rank_spread blocked       = spread_over_ranks(c.blocked_seconds);
+  struct rusage     usage;
+  getrusage(RUSAGE_SELF, &usage);
+  const rank_spread rss = spread_over_ranks(usage.ru_maxrss / 1024.0);
+
+  // every rank records the same number of levels, but pad to be safe
+  const uint64_t levels =
+      upcxx::reduce_all(uint64_t(c.frontier.size()),
+                        [](uint64_t a, uint64_t b) { return std::max(a, b); })
+          .wait();
+  c.frontier.resize(levels, 0);
+  std::vector<uint64_t> frontier_sum(levels), frontier_max(levels);
+  upcxx::reduce_one(c.frontier.data(), frontier_sum.data(), levels,
+                    [](uint64_t a, uint64_t b) { return a + b; }, 0)
+      .wait();
+  upcxx::reduce_one(c.frontier.data(), frontier_max.data(), levels,
+                    [](uint64_t a, uint64_t b) { return std::max(a, b); }, 0)
+      .wait();
+
+  std::ostringstream events;
+  for (const trace_event& e : c.events) {
+    events << ",\n{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"ts\": "
+           << e.start_us << ", \"dur\": " << e.duration_us
+           << ", \"pid\": " << me << ", \"tid\": 0}";
+  }
+  upcxx::dist_object<std::string> rank_events(
+      trace_file.empty() ? std::string() : events.str());
+
+  if (me == 0) {
+    // kernels may have left fixed notation set
+    const std::ios_base::fmtflags flags = std::cout.flags(std::ios_base::dec);
+    const std::streamsize precision = std::cout.precision(6);
+    // bytes received per rank, over both kinds
+    upcxx::intrank_t hot          = 0;
+    uint64_t         hottest      = 0;
+    uint64_t         total_ops[2] = {0, 0};
+    for (upcxx::intrank_t t = 0; t < p; ++t) {
+      uint64_t received = 0;
+      for (upcxx::intrank_t s = 0; s < p; ++s) {
+        received += matrix[(1 * p + s) * p + t] + matrix[(3 * p + s) * p + t];
+        total_ops[0] += matrix[(0 * p + s) * p + t];
+        total_ops[1] += matrix[(2 * p + s) * p + t];
+      }
+      if (received > hottest) {
+        hottest = received;
+        hot     = t;
+      }
+    }
+    std::cout << "One-sided: " << total_ops[0] << " operations, bytes "
+              << one_sided_bytes << std::endl;
+    std::cout << "RPC: " << total_ops[1] << " calls, bytes " << rpc_bytes
+              << std::endl;
+    std::cout << "Hot peer: rank " << hot << " receives " << hottest
+              << " bytes ("
+              << (one_sided_bytes.sum + rpc_bytes.sum > 0
+                      ? 100.0 * hottest /
+                            (one_sided_bytes.sum + rpc_bytes.sum)
+                      : 0.0)
+              << "% of all)" << std::endl;
+    std::cout << "Intersections: " << intersections << ", elements compared "
+              << elements << std::endl;
+    std::cout << "Blocked seconds: " << blocked << std::endl;
+    std::cout << "Peak RSS MB: " << rss << std::endl;
+    for (uint64_t l = 0; l < levels; ++l) {
+      std::cout << "Frontier level " << l << ": " << frontier_sum[l]
+                << " (max/mean per rank " << frontier_max[l] << " / "
+                << double(frontier_sum[l]) / p << ")" << std::endl;
+    }
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+
+    if (!matrix_file.empty()) {
+      std::ofstream out(matrix_file);
+      out << "source,target,one_sided_ops,one_sided_bytes,rpcs,rpc_bytes\n";
+      for (upcxx::intrank_t s = 0; s < p; ++s) {
+        for (upcxx::intrank_t t = 0; t < p; ++t) {
+          uint64_t cell[4];
+          for (int k = 0; k < 4; ++k) cell[k] = matrix[(k * p + s) * p + t];
+          if (!(cell[0] | cell[1] | cell[2] | cell[3])) continue;
+          out << s << ',' << t << ',' << cell[0] << ',' << cell[1] << ','
+              << cell[2] << ',' << cell[3] << '\n';
+        }
+      }
+    }
+    if (!trace_file.empty()) {
+      std::ofstream out(trace_file);
+      out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+          << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 0, "
+             "\"args\": {\"name\": \"rank 0\"}}";
+      for (upcxx::intrank_t r = 0; r < p; ++r) {
+        if (r > 0) {
+          out << ",\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": "
+              << r << ", \"args\": {\"name\": \"rank " << r << "\"}}";
+        }
+        out << rank_events.fetch(r).wait();
+      }
+      out << "\n]}\n";
+    }
+  }
+  // rank 0 may still be fetching the events of the others
+  upcxx::barrier();
+}
+
+#else
+
+inline void set_trace_epoch() {}
+inline void reset_counters() {}
+inline void note_one_sided(upcxx::intrank_t, uint64_t) {}
+inline void note_rpc(upcxx::intrank_t, uint64_t) {}
+inline void note_intersection(uint64_t, uint64_t) {}
+inline void note_frontier(uint64_t, uint64_t) {}
+inline void note_trace_event(const std::string&, double) {}
+inline double microseconds_since_epoch() { return 0; }
+
+class trace_scope {
+public:
+  explicit trace_scope(const char*) {}
+};
+
+class blocked_scope {
+public:
+  blocked_scope() {}
+};
+
+inline void report_instrumentation(const std::string& matrix_file,
+                                   const std::string& trace_file) {
+  if (upcxx::rank_me() == 0 && !(matrix_file.empty() && trace_file.empty())) {
+    std::cout << "Built without -DGRAPH_INSTRUMENT: no communication matrix "
+                 "or trace written"
+              << std::endl;
+  }
+}
+
+#endif
@@ -0,0 +1,387 @@
+// Count-only intersection of sorted adjacency lists.
+//
+// All kernels take two strictly increasing lists (CSR rows) and return the
+// number of common elements:
+//
+//   merge       - the scalar two-pointer merge, as std::set_intersection
+//   branchless  - the same merge with data-dependent branches turned into
+//                 arithmetic
+//   sse         - block compare of 4 (32-bit IDs) or 2 (64-bit IDs) elements
+//                 against every rotation of the other block, SSE4.1
+//   avx2        - the same with 8 or 4 elements per block
+//   avx512      - the same with 16 or 8 elements per block, AVX-512F
+//   galloping   - exponential search of every element of the short list in
+//                 the long one, for lists of very different lengths
+//   bitmap      - a bitmap over the value range of one row, probed by the
+//                 other; built once per row by row_intersector and reused
+//                 for every list it is intersected with
+//
+// intersect_count picks merge, galloping or a block-compare kernel the CPU
+// supports, from the list lengths and the CPU features detected at run time.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INTERSECTION_X86 1
+#endif
+
+enum class intersection_kernel {
+  merge,
+  branchless,
+  sse,
+  avx2,
+  avx512,
+  galloping,
+  bitmap
+};
+
+inline const char* kernel_name(intersection_kernel kernel) {
+  switch (kernel) {
+    case intersection_kernel::merge: return "merge";
+    case intersection_kernel::branchless: return "branchless";
+    case intersection_kernel::sse: return "sse";
+    case intersection_kernel::avx2: return "avx2";
+    case intersection_kernel::avx512: return "avx512";
+    case intersection_kernel::galloping: return "galloping";
+    case intersection_kernel::bitmap: return "bitmap";
+  }
+  return "unknown";
+}
+
+// Galloping is used once the longer list is this many times the shorter one
+// and has at least galloping_min_length entries.
+const size_t galloping_ratio      = 32;
+const size_t galloping_min_length = 256;
+
+// Lists shorter than this are merged: they do not fill a SIMD block.
+const size_t short_list_length = 8;
+
+// A row gets a bitmap when it has at least this many entries and its value
+// range needs at most this many bits per entry.
+const size_t bitmap_min_length    = 64;
+const size_t bitmap_bits_per_entry = 16;
+
+template <typename Id>
+size_t intersect_count_merge(const Id* a, size_t na, const Id* b, size_t nb) {
+  size_t i = 0, j = 0, count = 0;
+  while (i < na && j < nb) {
+    if (a[i] < b[j]) {
+      ++i;
+    } else if (b[j] < a[i]) {
+      ++j;
+    } else {
+      ++count;
+      ++i;
+      ++j;
+    }
+  }
+  return count;
+}
+
+template <typename Id>
+size_t intersect_count_branchless(const Id* a, size_t na, const Id* b,
+                                  size_t nb) {
+  size_t i = 0, j = 0, count = 0;
+  while (i < na && j < nb) {
+    const Id x = a[i], y = b[j];
+    count += x == y;
+    i += x <= y;
+    j += y <= x;
+  }
+  return count;
+}
+
+// Expects na <= nb.
+template <typename Id>
+size_t intersect_count_galloping(const Id* a, size_t na, const Id* b,
+                                 size_t nb) {
+  size_t count = 0, pos = 0;
+  for (size_t i = 0; i < na && pos < nb; ++i) {
+    const Id x     = a[i];
+    size_t   bound = 1;
+    while (pos + bound < nb && b[pos + bound] < x) bound *= 2;
+    // b[pos + bound / 2] < x when bound > 1, and b[pos + bound] >= x
+    pos = std::lower_bound(b + pos + bound / 2,
+                           b + std::min(pos + bound + 1, nb), x) -
+          b;
+    if (pos < nb && b[pos] == x) {
+      ++count;
+      ++pos;
+    }
+  }
+  return count;
+}
+
+#ifdef INTERSECTION_X86
+// Block compare: every element of a W-wide block of a is compared with every
+// element of a W-wide block of b by comparing a with all W rotations of b.
+// The block with the smaller last element is then consumed (both on a tie);
+// since the lists are strictly increasing no match is missed or counted
+// twice. The remaining tails go through the branchless merge.
+
+__attribute__((target("sse4.1"))) inline size_t intersect_count_sse(
+    const uint32_t* a, size_t na, const uint32_t* b, size_t nb) {
+  size_t i = 0, j = 0, count = 0;
+  while (i + 4 <= na && j + 4 <= nb) {
+    const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+    __m128i       m  = _mm_cmpeq_epi32(va, vb);
+    m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39)));
+    m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4E)));
+    m = _mm_or_si128(m, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93)));
+    count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(m)));
+    const uint32_t amax = a[i + 3], bmax = b[j + 3];
+    i += amax <= bmax ? 4 : 0;
+    j += bmax <= amax ? 4 : 0;
+  }
+  return count + intersect_count_branchless(a + i, na - i, b + j, nb - j);
+}
+
+__attribute__((target("sse4.1"))) inline size_t intersect_count_sse(
+    const uint64_t* a, size_t na, const uint64_t* b, size_t nb) {
+  size_t i = 0, j = 0, count = 0;
+  while (i + 2 <= na && j + 2 <= nb) {
+    const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+    const __m128i m  = _mm_or_si128(
+        _mm_cmpeq_epi64(va, vb),
+        _mm_cmpeq_epi64(va, _mm_shuffle_epi32(vb, 0x4E)));
+    count += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(m)));
+    const uint64_t amax = a[i + 1], bmax = b[j + 1];
+    i += amax <= bmax ? 2 : 0;
+    j += bmax <= amax ? 2 : 0;
+  }
+  return count + intersect_count_branchless(a + i, na - i, b + j, nb - j);
+}
+
+__attribute__((target("avx2"))) inline size_t intersect_count_avx2(
+    const uint32_t* a, size_t na, const uint32_t* b, size_t nb) {
+  const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+  size_t        i = 0, j = 0, count = 0;
+  while (i + 8 <= na && j + 8 <= nb) {
+    const __m256i va =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+    __m256i m  = _mm256_cmpeq_epi32(va, vb);
+    for (int r = 1; r < 8; ++r) {
+      vb = _mm256_permutevar8x32_epi32(vb, rotate);
+      m  = _mm256_or_si256(m, _mm256_cmpeq_epi32(va, vb));
+    }
+    count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+    const uint32_t amax = a[i + 7], bmax = b[j + 7];
+    i += amax <= bmax ? 8 : 0;
+    j += bmax <= amax ? 8 : 0;
+  }
+  return count + intersect_count_branchless(a + i, na - i, b + j, nb - j);
+}
+
+__attribute__((target("avx2"))) inline size_t intersect_count_avx2(
+    const uint64_t* a, size_t na, const uint64_t* b, size_t nb) {
+  size_t i = 0, j = 0, count = 0;
+  while (i + 4 <= na && j + 4 <= nb) {
+    const __m256i va =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    const __m256i vb =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+    __m256i m = _mm256_cmpeq_epi64(va, vb);
+    m = _mm256_or_si256(
+        m, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0x39)));
+    m = _mm256_or_si256(
+        m, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0x4E)));
+    m = _mm256_or_si256(
+        m, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, 0x93)));
+    count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+    const uint64_t amax = a[i + 3], bmax = b[j + 3];
+    i += amax <= bmax ? 4 : 0;
+    j += bmax <= amax ? 4 : 0;
+  }
+  return count + intersect_count_branchless(a + i, na - i, b + j, nb - j);
+}
+
+__attribute__((target("avx512f"))) inline size_t intersect_count_avx512(
+    const uint32_t* a, size_t na, const uint32_t* b, size_t nb) {
+  size_t        i = 0, j = 0, count = 0;
+  while (i + 16 <= na && j + 16 <= nb) {
+    const __m512i va = _mm512_loadu_si512(a + i);
+    __m512i       vb = _mm512_loadu_si512(b + j);
+    __mmask16     m  = _mm512_cmpeq_epi32_mask(va, vb);
+    for (int r = 1; r < 16; ++r) {
+      vb = _mm512_maskz_alignr_epi32(0xFFFF, vb, vb, 1);
+      m |= _mm512_cmpeq_epi32_mask(va, vb);
+    }
+    count += __builtin_popcount(m);
+    const uint32_t amax = a[i + 15], bmax = b[j + 15];
+    i += amax <= bmax ? 16 : 0;
+    j += bmax <= amax ? 16 : 0;
+  }
+  return count + intersect_count_branchless(a + i, na - i, b + j, nb - j);
+}
+
+__attribute__((target("avx512f"))) inline size_t intersect_count_avx512(
+    const uint64_t* a, size_t na, const uint64_t* b, size_t nb) {
+  size_t        i = 0, j = 0, count = 0;
+  while (i + 8 <= na && j + 8 <= nb) {
+    const __m512i va = _mm512_loadu_si512(a + i);
+    __m512i       vb = _mm512_loadu_si512(b + j);
+    __mmask8      m  = _mm512_cmpeq_epi64_mask(va, vb);
+    for (int r = 1; r < 8; ++r) {
+      vb = _mm512_maskz_alignr_epi64(0xFF, vb, vb, 1);
+      m |= _mm512_cmpeq_epi64_mask(va, vb);
+    }
+    count += __builtin_popcount(m);
+    const uint64_t amax = a[i + 7], bmax = b[j + 7];
+    i += amax <= bmax ? 8 : 0;
+    j += bmax <= amax ? 8 : 0;
+  }
+  return count + intersect_count_branchless(a + i, na - i, b + j, nb - j);
+}
+#endif
+
+// Whether kernel can run on this CPU.
+inline bool kernel_supported(intersection_kernel kernel) {
+  switch (kernel) {
+#ifdef INTERSECTION_X86
+    case intersection_kernel::sse: return __builtin_cpu_supports("sse4.1");
+    case intersection_kernel::avx2: return __builtin_cpu_supports("avx2");
+    case intersection_kernel::avx512:
+      return __builtin_cpu_supports("avx512f");
+#else
+    case intersection_kernel::sse:
+    case intersection_kernel::avx2:
+    case intersection_kernel::avx512: return false;
+#endif
+    default: return true;
+  }
+}
+
+// The block-compare kernel used on this CPU, or the branchless merge. AVX2 is
+// preferred to AVX-512: graph rows rarely fill many 16-element blocks, and
+// AVX2 was faster on every graph in data/ (see intersection_benchmark.cpp).
+inline intersection_kernel best_block_kernel() {
+  static const intersection_kernel best =
+      kernel_supported(intersection_kernel::avx2)
+          ? intersection_kernel::avx2
+          : kernel_supported(intersection_kernel::avx512)
+                ? intersection_kernel::avx512
+                : kernel_supported(intersection_kernel::sse)
+                      ? intersection_kernel::sse
+                      : intersection_kernel::branchless;
+  return best;
+}
+
+// Runs one specific kernel, which must be supported; bitmap builds a
+// throwaway bitmap of the longer list.
+template <typename Id>
+size_t intersect_count_with(intersection_kernel kernel, const Id* a, size_t na,
+                            const Id* b, size_t nb);
+
+// Intersects a row with many other lists, through a bitmap of the row when
+// it is long and dense enough and through intersect_count otherwise.
+template <typename Id>
+class row_intersector {
+public:
+  row_intersector() = default;
+  row_intersector(const Id* a, size_t na) { reset(a, na); }
+
+  // Switches to a new row; the bitmap storage is reused. force_bitmap builds
+  // the bitmap whatever the length and density of the row.
+  void reset(const Id* a, size_t na, bool force_bitmap = false) {
+    row    = a;
+    length = na;
+    bits.clear();
+    if (na == 0 || (!force_bitmap && na < bitmap_min_length)) return;
+    first = a[0];
+    range = uint64_t{a[na - 1]} - first + 1;
+    if (!force_bitmap && range / bitmap_bits_per_entry > na) return;
+    bits.assign((range + 63) / 64, 0);
+    for (size_t i = 0; i < na; ++i) {
+      const uint64_t offset = a[i] - first;
+      bits[offset / 64] |= uint64_t{1} << (offset % 64);
+    }
+  }
+
+  bool has_bitmap() const { return !bits.empty(); }
+
+  size_t count(const Id* b, size_t nb) const;
+
+private:
+  size_t probe(const Id* b, size_t nb) const {
+    size_t count = 0;
+    for (size_t j = 0; j < nb; ++j) {
+      const uint64_t offset = b[j] - first;    // wraps for b[j] < first
+      count += offset < range && ((bits[offset / 64] >> (offset % 64)) & 1);
+    }
+    return count;
+  }
+
+  const Id*             row    = nullptr;
+  size_t                length = 0;
+  uint64_t              first  = 0;
+  uint64_t              range  = 0;
+  std::vector<uint64_t> bits;
+};
+
+// Counts the common elements of two strictly increasing lists with the
+// kernel best suited to their lengths and to this CPU.
+template <typename Id>
+size_t intersect_count(const Id* a, size_t na, const Id* b, size_t nb) {
+  if (na > nb) {
+    std::swap(a, b);
+    std::swap(na, nb);
+  }
+  if (na == 0) return 0;
+  if (na * galloping_ratio < nb && nb >= galloping_min_length) {
+    return intersect_count_galloping(a, na, b, nb);
+  }
+  if (na < short_list_length) return intersect_count_merge(a, na, b, nb);
+  return intersect_count_with(best_block_kernel(), a, na, b, nb);
+}
+
+template <typename Id>
+size_t intersect_count_with(intersection_kernel kernel, const Id* a, size_t na,
+                            const Id* b, size_t nb) {
+  switch (kernel) {
+    case intersection_kernel::merge:
+      return intersect_count_merge(a, na, b, nb);
+    case intersection_kernel::branchless:
+      return intersect_count_branchless(a, na, b, nb);
+#ifdef INTERSECTION_X86
+    case intersection_kernel::sse: return intersect_count_sse(a, na, b, nb);
+    case intersection_kernel::avx2: return intersect_count_avx2(a, na, b, nb);
+    case intersection_kernel::avx512:
+      return intersect_count_avx512(a, na, b, nb);
+#else
+    case intersection_kernel::sse:
+    case intersection_kernel::avx2:
+    case intersection_kernel::avx512:
+      return intersect_count_branchless(a, na, b, nb);
+#endif
+    case intersection_kernel::galloping:
+      return na <= nb ? intersect_count_galloping(a, na, b, nb)
+                      : intersect_count_galloping(b, nb, a, na);
+    case intersection_kernel::bitmap: {
+      if (na < nb) {
+        std::swap(a, b);
+        std::swap(na, nb);
+      }
+      row_intersector<Id> row;
+      row.reset(a, na, true);
+      return row.count(b, nb);
+    }
+  }
+  return intersect_count_merge(a, na, b, nb);
+}
+
+template <typename Id>
+size_t row_intersector<Id>::count(const Id* b, size_t nb) const {
+  // Probing costs one bit test per element of b, so the bitmap is used
+  // whenever b is the shorter list.
+  if (has_bitmap() && nb <= length) return probe(b, nb);
+  return intersect_count(row, length, b, nb);
+}
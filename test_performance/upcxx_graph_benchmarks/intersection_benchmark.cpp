@@ -0,0 +1,193 @@
+/*
+ * Microbenchmark of the intersection kernels in intersection.hpp.
+ *
+ * Loads a CSR file (any layout the converters write) and runs the triangle
+ * counting workload -- the intersection of the adjacency lists of both
+ * endpoints of every edge -- once per kernel, checking every kernel against
+ * the scalar merge. Runs on one core and does not need UPC++.
+ */
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+#include "csr_file.hpp"
+#include "intersection.hpp"
+
+std::string edgelistFile = "";
+int         repeat       = 3;
+bool        degreeOrdered = false;
+
+double GetCurrentTime() {
+  static struct timeval  tv;
+  static struct timezone tz;
+  gettimeofday(&tv, &tz);
+  return tv.tv_sec + 1.e-6 * tv.tv_usec;
+}
+
+template <typename Id>
+struct local_csr {
+  std::vector<uint64_t> offsets;
+  std::vector<Id>       adjacency;
+
+  const Id* row(uint64_t v) const { return adjacency.data() + offsets[v]; }
+  size_t    degree(uint64_t v) const { return offsets[v + 1] - offsets[v]; }
+};
+
+// Loads the whole graph; with degreeOrdered only the neighbors later in
+// (degree, id) order are kept, as triangle_counting --degree-order does.
+template <typename Id>
+void load(const csr_file& input, local_csr<Id>& graph) {
+  const uint64_t n = input.num_vertices();
+  graph.offsets.assign(1, 0);
+  std::vector<Id> row;
+  for (uint64_t v = 0; v < n; ++v) {
+    row.resize(input.degree(v));
+    input.read_row(v, row.data());
+    for (Id u : row) {
+      const uint64_t du = input.degree(u), dv = input.degree(v);
+      if (!degreeOrdered || dv < du || (dv == du && v < u)) {
+        graph.adjacency.push_back(u);
+      }
+    }
+    graph.offsets.push_back(graph.adjacency.size());
+  }
+}
+
+// Runs count(v, u) for every stored edge (v, u) with v < u (every stored
+// edge when degreeOrdered) and returns the total and the best time in ms.
+template <typename Id, typename Count>
+size_t run(const local_csr<Id>& graph, Count count, double& best_ms) {
+  size_t total = 0;
+  best_ms      = 0;
+  for (int r = 0; r < repeat; ++r) {
+    total              = 0;
+    const double start = GetCurrentTime();
+    for (uint64_t v = 0; v + 1 < graph.offsets.size(); ++v) {
+      const Id* row = graph.row(v);
+      for (size_t j = 0; j < graph.degree(v); ++j) {
+        const Id u = row[j];
+        if (degreeOrdered || v < u) total += count(v, u);
+      }
+    }
+    const double ms = 1000 * (GetCurrentTime() - start);
+    if (r == 0 || ms < best_ms) best_ms = ms;
+  }
+  return total;
+}
+
+template <typename Id>
+void benchmark(const csr_file& input) {
+  local_csr<Id> graph;
+  load(input, graph);
+  std::cout << "|V| = " << input.num_vertices()
+            << ", stored adjacencies = " << graph.adjacency.size()
+            << ", ID width = " << 8 * sizeof(Id) << " bits"
+            << (degreeOrdered ? ", degree ordered" : "") << std::endl;
+
+  double       merge_ms  = 0;
+  const size_t reference = run(
+      graph,
+      [&](uint64_t v, uint64_t u) {
+        return intersect_count_merge(graph.row(v), graph.degree(v),
+                                     graph.row(u), graph.degree(u));
+      },
+      merge_ms);
+
+  auto report = [&](const std::string& name, size_t total, double ms) {
+    std::cout << std::left << std::setw(12) << name << std::right
+              << std::setw(12) << std::fixed << std::setprecision(3) << ms
+              << " ms" << std::setw(9) << std::setprecision(2)
+              << merge_ms / ms << "x" << std::setw(14) << total
+              << (total == reference ? "" : "  MISMATCH") << std::endl;
+  };
+  std::cout << std::left << std::setw(12) << "kernel" << std::right
+            << std::setw(15) << "best time" << std::setw(10) << "speedup"
+            << std::setw(14) << "common" << std::endl;
+  report("merge", reference, merge_ms);
+
+  for (auto kernel :
+       {intersection_kernel::branchless, intersection_kernel::sse,
+        intersection_kernel::avx2, intersection_kernel::avx512,
+        intersection_kernel::galloping}) {
+    if (!kernel_supported(kernel)) {
+      std::cout << std::left << std::setw(12) << kernel_name(kernel)
+                << std::right << "  not supported by this CPU" << std::endl;
+      continue;
+    }
+    double       ms    = 0;
+    const size_t total = run(
+        graph,
+        [&](uint64_t v, uint64_t u) {
+          return intersect_count_with(kernel, graph.row(v), graph.degree(v),
+                                      graph.row(u), graph.degree(u));
+        },
+        ms);
+    report(kernel_name(kernel), total, ms);
+  }
+
+  // Bitmaps pay off only when reused, so they are measured as the kernels
+  // use them: one row_intersector per vertex, probed by all of its neighbors.
+  row_intersector<Id> row;
+  uint64_t            current = UINT64_MAX;
+  auto                per_row = [&](bool force_bitmap) {
+    current = UINT64_MAX;
+    return [&, force_bitmap](uint64_t v, uint64_t u) {
+      if (v != current) {
+        row.reset(graph.row(v), graph.degree(v), force_bitmap);
+        current = v;
+      }
+      return row.count(graph.row(u), graph.degree(u));
+    };
+  };
+  double       ms      = 0;
+  const size_t bitmaps = run(graph, per_row(true), ms);
+  report("bitmap", bitmaps, ms);
+
+  const size_t total = run(
+      graph,
+      [&](uint64_t v, uint64_t u) {
+        return intersect_count(graph.row(v), graph.degree(v), graph.row(u),
+                               graph.degree(u));
+      },
+      ms);
+  report("auto", total, ms);
+
+  const size_t with_bitmaps = run(graph, per_row(false), ms);
+  report("auto+rows", with_bitmaps, ms);
+  std::cout << "Block kernel picked for this CPU: "
+            << kernel_name(best_block_kernel()) << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  int argIndex = 1;
+  while (argIndex < argc) {
+    std::string arg(argv[argIndex]);
+    if (arg == "--edgelistfile") {
+      ++argIndex;
+      edgelistFile = std::string(argv[argIndex]);
+      ++argIndex;
+    } else if (arg == "--repeat") {
+      ++argIndex;
+      repeat = std::stoi(argv[argIndex]);
+      ++argIndex;
+    } else if (arg == "--degree-order") {
+      ++argIndex;
+      degreeOrdered = true;
+    } else {
+      std::cerr << "Unknown option " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  csr_file input(edgelistFile);
+  if (csr_id_bytes(input.num_vertices()) == sizeof(uint32_t)) {
+    benchmark<uint32_t>(input);
+  } else {
+    benchmark<uint64_t>(input);
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+// Hand-off of off-node adjacency fetches between OpenMP worker threads and
+// one communication thread, for the hybrid UPC++ + OpenMP kernels.
+//
+// Workers submit (local vertex, remote neighbor) requests in batches and
+// take back (local vertex, neighbor list) pairs once the list has arrived.
+// Only the communication thread, which must hold the master persona, calls
+// service(): it issues the fetches through an adjacency_cache, bounded by an
+// inflight_window, and drives progress, so UPC++ is only ever entered from
+// that thread. Both queues are guarded by one mutex and exchanged in bulk.
+//
+// The number of workers is set with set_workers() from inside the parallel
+// region, once the size of the team is known. The communication thread
+// reports done() once every worker has called finish_requests() and every
+// fetch has completed; at that point every list is in the ready queue.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "adjacency_cache.hpp"
+#include "flow_control.hpp"
+
+template <typename Id>
+class offnode_fetcher {
+public:
+  using list_ptr = typename adjacency_cache<Id>::list_ptr;
+
+  struct request {
+    uint64_t source_index;
+    uint64_t neighbor;
+  };
+  struct ready {
+    uint64_t source_index;
+    list_ptr list;
+  };
+
+  offnode_fetcher(adjacency_cache<Id>& cache, size_t max_in_flight)
+      : cache(cache), window(max_in_flight) {}
+
+  // Sets the number of workers that will call finish_requests(); must
+  // happen before any thread calls service().
+  void set_workers(int workers) { active_workers = workers; }
+
+  // Worker side: queues requests (and empties them).
+  void submit(std::vector<request>& requests) {
+    if (requests.empty()) return;
+    std::lock_guard<std::mutex> lock(queues);
+    submitted.insert(submitted.end(), requests.begin(), requests.end());
+    requests.clear();
+  }
+
+  // Worker side: no more requests will come from the calling worker.
+  void finish_requests() { --active_workers; }
+
+  // Any thread: moves the lists that have arrived into out; false if none.
+  bool take(std::vector<ready>& out) {
+    std::lock_guard<std::mutex> lock(queues);
+    if (arrived.empty()) return false;
+    out.swap(arrived);
+    arrived.clear();
+    return true;
+  }
+
+  // Communication thread: issues the queued requests and makes progress.
+  void service() {
+    {
+      std::lock_guard<std::mutex> lock(queues);
+      issuing.swap(submitted);
+    }
+    for (const request& r : issuing) {
+      const uint64_t source_index = r.source_index;
+      window.track(cache.fetch(r.neighbor).then([this, source_index](
+                                                    list_ptr list) {
+        std::lock_guard<std::mutex> lock(queues);
+        arrived.push_back(ready{source_index, list});
+      }));
+    }
+    issuing.clear();
+    upcxx::progress();
+    if (active_workers == 0 && window.in_flight() == 0) {
+      std::lock_guard<std::mutex> lock(queues);
+      if (submitted.empty()) finished = true;
+    }
+  }
+
+  // Any thread: every fetch has completed and its list is queued.
+  bool done() const { return finished; }
+
+private:
+  adjacency_cache<Id>& cache;
+  inflight_window      window;
+  std::atomic<int>     active_workers{0};
+  std::atomic<bool>    finished{false};
+  std::mutex           queues;
+  std::vector<request> submitted;
+  std::vector<request> issuing;
+  std::vector<ready>   arrived;
+};
@@ -0,0 +1,168 @@
+// Compute-at-owner intersections for distributed triangle counting.
+//
+// Instead of pulling the adjacency list of a remote neighbor u of v, the
+// requester can push v's list to the owner of u, which intersects it with
+// its local row of u and sends back the number of common neighbors. This
+// moves deg(v) IDs instead of deg(u), which pays off when u is a hub.
+//
+// Pushes are aggregated per destination rank. A batch is a flat array of
+// records
+//
+//   [deg(v), adjacency of v, number of targets k, offsets of k targets]
+//
+// in which every target is a vertex of the destination rank (by its offset
+// there) to intersect with v's list. Consecutive pushes of the same v to a
+// rank share one record, so v's list travels once per rank. A batch is sent
+// as one upcxx::rpc when a record is to be added to a batch of at least
+// batch_ids IDs, and when flushed; records are never split. The RPC returns
+// the number of common neighbors over the whole batch.
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <upcxx/upcxx.hpp>
+
+#include "csr_loader.hpp"
+#include "flow_control.hpp"
+#include "instrumentation.hpp"
+#include "intersection.hpp"
+
+// How triangle_counting obtains the intersection of two rows.
+enum class execution_mode {
+  // always fetch the remote row (rget)
+  pull,
+  // always send the local row to the owner of the remote one (rpc)
+  push,
+  // push when the remote row is at least push_ratio times longer
+  hybrid
+};
+
+inline execution_mode parse_execution_mode(const std::string& mode) {
+  if (mode == "pull") return execution_mode::pull;
+  if (mode == "push") return execution_mode::push;
+  if (mode == "hybrid") return execution_mode::hybrid;
+  throw std::runtime_error("Unknown execution mode: " + mode);
+}
+
+const uint64_t no_open_record = ~uint64_t{0};
+
+template <typename Id>
+class intersection_pusher {
+public:
+  // Collective: every rank constructs its pusher at the same point.
+  intersection_pusher(const distributed_csr<Id>& graph, inflight_window& window,
+                      size_t batch_ids)
+      : graph(graph),
+        window(window),
+        batch_ids(batch_ids),
+        owner_graph(&graph),
+        batches(upcxx::rank_n()),
+        open_source(upcxx::rank_n(), no_open_record),
+        open_count(upcxx::rank_n(), 0) {}
+
+  // Queues the intersection of the row of local vertex source_index with the
+  // row of neighbor, which rank owns.
+  void push(uint64_t source_index, uint64_t neighbor) {
+    const upcxx::intrank_t rank  = vertex_id_to_rank(neighbor);
+    std::vector<Id>&       batch = batches[rank];
+    if (open_source[rank] != source_index) {
+      if (batch.size() >= batch_ids) send(rank);
+      const gptr_and_len<Id>& row = graph.local(source_index);
+      batch.push_back(row.n);
+      batch.insert(batch.end(), row.p.local(), row.p.local() + row.n);
+      open_count[rank] = batch.size();
+      batch.push_back(0);
+      open_source[rank] = source_index;
+      ++pushed_rows;
+    }
+    ++batch[open_count[rank]];
+    batch.push_back(vertex_id_to_offset(neighbor));
+    ++pushed_pairs;
+  }
+
+  // Sends every partial batch.
+  void flush() {
+    for (upcxx::intrank_t r = 0; r < upcxx::rank_n(); ++r) {
+      if (!batches[r].empty()) send(r);
+    }
+  }
+
+  // Common neighbors counted by the owners of completed batches.
+  size_t count() const { return counted; }
+
+  // Pairs and rows pushed, and IDs sent.
+  uint64_t pairs() const { return pushed_pairs; }
+  uint64_t rows() const { return pushed_rows; }
+  uint64_t ids_sent() const { return sent_ids; }
+
+private:
+  void send(upcxx::intrank_t rank) {
+    std::vector<Id>& batch = batches[rank];
+    sent_ids += batch.size();
+    note_rpc(rank, batch.size() * sizeof(Id));
+    window.track(
+        upcxx::rpc(rank,
+                   [](upcxx::dist_object<const distributed_csr<Id>*>& owner,
+                      upcxx::view<Id> records) {
+                     return intersect_records(**owner, records.begin(),
+                                              records.size());
+                   },
+                   owner_graph, upcxx::make_view(batch.begin(), batch.end()))
+            .then([this](size_t common) { counted += common; }));
+    // The view is serialized at injection, so the batch can be reused.
+    batch.clear();
+    open_source[rank] = no_open_record;
+  }
+
+  static size_t intersect_records(const distributed_csr<Id>& graph,
+                                  const Id* records, size_t n) {
+    size_t              common = 0;
+    row_intersector<Id> row;
+    for (size_t pos = 0; pos < n;) {
+      const size_t length = records[pos++];
+      row.reset(records + pos, length);
+      pos += length;
+      const size_t targets = records[pos++];
+      for (size_t t = 0; t < targets; ++t) {
+        const gptr_and_len<Id>& target = graph.local(records[pos++]);
+        note_intersection(length, target.n);
+        common += row.count(target.p.local(), target.n);
+      }
+    }
+    return common;
+  }
+
+  const distributed_csr<Id>&                     graph;
+  inflight_window&                               window;
+  const size_t                                   batch_ids;
+  upcxx::dist_object<const distributed_csr<Id>*> owner_graph;
+  std::vector<std::vector<Id>>                   batches;
+  // the source vertex of the open record of each batch, and the position of
+  // its target count
+  std::vector<uint64_t>                          open_source;
+  std::vector<size_t>                            open_count;
+  size_t                                         counted      = 0;
+  uint64_t                                       pushed_pairs = 0;
+  uint64_t                                       pushed_rows  = 0;
+  uint64_t                                       sent_ids     = 0;
+};
+
+// Sums the push counters of all ranks and prints them on rank 0.
+template <typename Id>
+void report_push_stats(const intersection_pusher<Id>& pusher) {
+  const uint64_t local[3] = {pusher.pairs(), pusher.rows(), pusher.ids_sent()};
+  uint64_t       total[3] = {0, 0, 0};
+  upcxx::reduce_one(local, total, 3,
+                    [](uint64_t a, uint64_t b) { return a + b; }, 0)
+      .wait();
+  if (upcxx::rank_me() == 0) {
+    std::cout << "Pushed intersections: " << total[0] << " pairs, "
+              << total[1] << " rows, " << total[2] * sizeof(Id)
+              << " bytes sent" << std::endl;
+  }
+}
@@ -0,0 +1,136 @@
+// Distribution of the vertices of a CSR graph over ranks, independent of
+// UPC++ so that partition_report can compare the schemes without running a
+// kernel.
+//
+// Every rank owns a set of vertices together with their adjacency lists and
+// numbers them 0, 1, ... in vertex order (the local index, or offset, of a
+// vertex on its owner). The 1D schemes are
+//
+//   cyclic      vertex v on rank v % p: balances vertex counts
+//   block       ceil(n / p) consecutive vertices per rank
+//   edge-block  consecutive vertices, cut where the offsets prefix sum
+//               crosses multiples of |E| / p: balances edge counts
+//
+// The 2D checkerboard scheme arranges the ranks as a rows x cols grid and
+// gives rank (i, j) the edges from row block i to column block j, so a
+// vertex's adjacency list is split over a grid row. Its vertices (and their
+// labels) are owned in block order. The kernels need whole adjacency lists
+// at one owner, so only partition_report evaluates it.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "csr_file.hpp"
+
+enum class partition_kind { cyclic, block, edge_block, checkerboard };
+
+inline partition_kind parse_partition_kind(const std::string& kind) {
+  if (kind == "cyclic") return partition_kind::cyclic;
+  if (kind == "block") return partition_kind::block;
+  if (kind == "edge-block") return partition_kind::edge_block;
+  if (kind == "2d") return partition_kind::checkerboard;
+  throw std::runtime_error("Unknown partition: " + kind);
+}
+
+inline const char* partition_name(partition_kind kind) {
+  switch (kind) {
+    case partition_kind::cyclic: return "cyclic";
+    case partition_kind::block: return "block";
+    case partition_kind::edge_block: return "edge-block";
+    default: return "2d";
+  }
+}
+
+class vertex_partition {
+public:
+  vertex_partition() = default;
+
+  vertex_partition(partition_kind kind, const csr_file& input, int ranks)
+      : kind(kind), ranks(ranks), n(input.num_vertices()) {
+    if (kind == partition_kind::cyclic) return;
+    block_length = std::max<uint64_t>((n + ranks - 1) / ranks, 1);
+    first.resize(ranks + 1);
+    for (int r = 0; r <= ranks; ++r) {
+      first[r] = std::min<uint64_t>(r * block_length, n);
+    }
+    if (kind == partition_kind::edge_block) {
+      // first vertex whose offset reaches r * |E| / p
+      const uint64_t edges = input.num_edges();
+      for (int r = 1; r < ranks; ++r) {
+        const uint64_t target = edges / ranks * r + edges % ranks * r / ranks;
+        uint64_t       lo = first[r - 1], hi = n;
+        while (lo < hi) {
+          const uint64_t mid = lo + (hi - lo) / 2;
+          if (input.edge_offset(mid) < target) {
+            lo = mid + 1;
+          } else {
+            hi = mid;
+          }
+        }
+        first[r] = lo;
+      }
+    }
+    if (kind == partition_kind::checkerboard) {
+      rows = static_cast<int>(std::sqrt(static_cast<double>(ranks)));
+      while (ranks % rows != 0) --rows;
+      cols = ranks / rows;
+    }
+  }
+
+  partition_kind scheme() const { return kind; }
+
+  int owner(uint64_t v) const {
+    if (kind == partition_kind::cyclic) return v % ranks;
+    if (kind != partition_kind::edge_block) return v / block_length;
+    return std::upper_bound(first.begin(), first.end(), v) - first.begin() - 1;
+  }
+
+  // Local index of v on its owner.
+  uint64_t offset(uint64_t v) const {
+    if (kind == partition_kind::cyclic) return v / ranks;
+    return v - first[owner(v)];
+  }
+
+  // Vertex of local index on rank.
+  uint64_t vertex(int rank, uint64_t index) const {
+    if (kind == partition_kind::cyclic) return index * ranks + rank;
+    return first[rank] + index;
+  }
+
+  uint64_t owned_by(int rank) const {
+    if (kind == partition_kind::cyclic) return (n + ranks - 1 - rank) / ranks;
+    return first[rank + 1] - first[rank];
+  }
+
+  // Most vertices any rank owns.
+  uint64_t max_owned() const {
+    uint64_t most = 0;
+    for (int r = 0; r < ranks; ++r) most = std::max(most, owned_by(r));
+    return most;
+  }
+
+  // Owner of edge (u, v) in the checkerboard scheme.
+  int edge_owner(uint64_t u, uint64_t v) const {
+    const uint64_t row_length = (n + rows - 1) / rows;
+    const uint64_t col_length = (n + cols - 1) / cols;
+    return static_cast<int>(u / row_length) * cols +
+           static_cast<int>(v / col_length);
+  }
+  int grid_rows() const { return rows; }
+  int grid_cols() const { return cols; }
+
+private:
+  partition_kind kind  = partition_kind::cyclic;
+  int            ranks = 1;
+  uint64_t       n     = 0;
+  // block kinds: first vertex of every rank, then n
+  std::vector<uint64_t> first;
+  uint64_t              block_length = 1;
+  int                   rows = 1, cols = 1;
+};
@@ -0,0 +1,79 @@
+/*
+ * Compares the vertex and edge balance of the partitions in partition.hpp
+ * for a CSR file and a number of ranks, including the 2D checkerboard that
+ * the kernels cannot run on. Runs on one core and does not need UPC++.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "csr_file.hpp"
+#include "partition.hpp"
+
+std::string edgelistFile = "";
+int         ranks        = 64;
+
+// Prints the smallest, mean and largest of the per-rank counts.
+void print_balance(const char* what, const std::vector<uint64_t>& counts) {
+  uint64_t total = 0;
+  for (uint64_t c : counts) total += c;
+  const double   mean = double(total) / counts.size();
+  const uint64_t most = *std::max_element(counts.begin(), counts.end());
+  std::cout << "  " << what << " per rank: min "
+            << *std::min_element(counts.begin(), counts.end()) << ", mean "
+            << std::fixed << std::setprecision(1) << mean << ", max " << most
+            << ", max/mean " << std::setprecision(3)
+            << (mean > 0 ? most / mean : 1.0) << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  int argIndex = 1;
+  while (argIndex < argc) {
+    std::string arg(argv[argIndex]);
+    if (arg == "--edgelistfile") {
+      ++argIndex;
+      edgelistFile = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--ranks") {
+      ++argIndex;
+      ranks = std::stoi(argv[argIndex]);
+      ++argIndex;
+    }
+  }
+
+  csr_file input(edgelistFile);
+  std::cout << input.num_vertices() << " vertices, " << input.num_edges()
+            << " adjacency entries, " << ranks << " ranks" << std::endl;
+
+  for (partition_kind kind :
+       {partition_kind::cyclic, partition_kind::block,
+        partition_kind::edge_block, partition_kind::checkerboard}) {
+    vertex_partition      partition(kind, input, ranks);
+    std::vector<uint64_t> vertices(ranks), edges(ranks);
+    std::vector<uint64_t> row;
+    for (int r = 0; r < ranks; ++r) vertices[r] = partition.owned_by(r);
+    for (uint64_t v = 0; v < input.num_vertices(); ++v) {
+      if (kind != partition_kind::checkerboard) {
+        edges[partition.owner(v)] += input.degree(v);
+        continue;
+      }
+      row.resize(input.degree(v));
+      input.read_row(v, row.data());
+      for (uint64_t u : row) ++edges[partition.edge_owner(v, u)];
+    }
+    std::cout << partition_name(kind);
+    if (kind == partition_kind::checkerboard) {
+      std::cout << " (" << partition.grid_rows() << " x "
+                << partition.grid_cols() << " grid)";
+    }
+    std::cout << std::endl;
+    print_balance("vertices", vertices);
+    print_balance("edges", edges);
+  }
+  return 0;
+}
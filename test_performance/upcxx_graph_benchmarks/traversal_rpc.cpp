@@ -0,0 +1,151 @@
+/*Authors: Marcin Zalewski / Jesun Sahariar Firoz*/
+
+// Level-free BFS and SSSP over aggregated UPC++ RPCs (see
+// async_traversal.hpp).
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <upcxx/upcxx.hpp>
+
+#include "async_traversal.hpp"
+#include "benchmark_harness.hpp"
+#include "csr_loader.hpp"
+
+std::string edgelistFile = "";
+// Distribution of the vertices over ranks: cyclic, block or edge-block
+std::string partition = "cyclic";
+// bfs (unit weights) or sssp (hashed weights in [1, maxWeight])
+std::string algorithm = "bfs";
+uint64_t    maxWeight = 255;
+// Width of the delta-stepping buckets; 0 picks 1 for BFS and maxWeight / 8
+// for SSSP
+uint64_t delta = 0;
+// Relaxations aggregated per destination rank before an RPC is sent
+size_t batchUpdates = 4096;
+// Warmup and timed repetitions, and where to write their times
+benchmark_options benchmarkOptions;
+
+// Traverses the loaded graph from source once, as one repetition.
+template <typename Id>
+void traverse_once(const distributed_csr<Id>& graph, uint64_t source,
+                   benchmark_harness& harness) {
+  const uint64_t weight = algorithm == "bfs" ? 1 : maxWeight;
+  const uint64_t width =
+      delta > 0 ? delta : std::max<uint64_t>(weight / 8, 1);
+  async_traversal<Id> engine(graph, weight, width, batchUpdates);
+
+  harness.start("compute");
+  engine.run(source);
+  harness.stop();
+
+  harness.start("reduce");
+  uint64_t local[6] = {0, 0, 0, engine.relaxations(), engine.updates_sent(),
+                       engine.batches_sent()};
+  uint64_t farthest = 0;
+  for (uint64_t i = 0; i < graph.num_vertices_per_rank; ++i) {
+    if (engine.distance_of(i) == unreached) continue;
+    ++local[0];
+    local[1] += engine.distance_of(i);
+    farthest = std::max(farthest, engine.distance_of(i));
+  }
+  local[2] = engine.reductions();
+  uint64_t total[6] = {0, 0, 0, 0, 0, 0};
+  upcxx::reduce_one(local, total, 6,
+                    [](uint64_t a, uint64_t b) { return a + b; }, 0)
+      .wait();
+  const uint64_t max_distance =
+      upcxx::reduce_one(farthest,
+                        [](uint64_t a, uint64_t b) { return std::max(a, b); },
+                        0)
+          .wait();
+  harness.stop();
+  if (!harness.last_repetition()) return;
+  if (upcxx::rank_me() == 0) {
+    std::cout << "Total time " << 1000 * harness.seconds("compute") << " ms."
+              << std::endl;
+    harness.metric("reached", total[0]);
+    harness.metric("distance_sum", total[1]);
+    std::cout << "Reached " << total[0] << " vertices, "
+              << (algorithm == "bfs" ? "depth" : "distance") << " at most "
+              << max_distance << ", sum of distances " << total[1]
+              << std::endl;
+    std::cout << "Relaxations: " << total[3] << ", updates sent: " << total[4]
+              << " in " << total[5] << " batches, termination reductions: "
+              << total[2] / upcxx::rank_n() << std::endl;
+  }
+}
+
+// Loads the graph with Id-wide vertex IDs and traverses it from source.
+template <typename Id>
+void traverse(uint64_t source) {
+  if (algorithm != "bfs" && algorithm != "sssp") {
+    throw std::runtime_error("Unknown algorithm: " + algorithm);
+  }
+  benchmark_harness harness("traversal_rpc", edgelistFile, benchmarkOptions);
+  harness.start("load");
+  distributed_csr<Id> graph;
+  readBinaryFormat(edgelistFile, graph, csr_orientation::symmetric,
+                   parse_partition_kind(partition));
+  harness.stop();
+
+  while (harness.next_repetition()) traverse_once(graph, source, harness);
+  harness.report();
+}
+
+int main(int argc, char* argv[]) {
+  upcxx::init();
+
+  int      argIndex = 1;
+  uint64_t source   = 0;
+  while (argIndex < argc) {
+    std::string arg(argv[argIndex]);
+    if (parse_benchmark_option(argv, argIndex, benchmarkOptions)) continue;
+    if (arg == "--edgelistfile") {
+      ++argIndex;
+      edgelistFile = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--partition") {
+      ++argIndex;
+      partition = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--source") {
+      ++argIndex;
+      source = std::stoul(argv[argIndex], nullptr, 0);
+      ++argIndex;
+    }
+    if (arg == "--algorithm") {
+      ++argIndex;
+      algorithm = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--max-weight") {
+      ++argIndex;
+      maxWeight = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--delta") {
+      ++argIndex;
+      delta = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--batch") {
+      ++argIndex;
+      batchUpdates = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+  }
+  if (use_32bit_ids(edgelistFile)) {
+    traverse<uint32_t>(source);
+  } else {
+    traverse<uint64_t>(source);
+  }
+
+  upcxx::finalize();
+  return 0;
+}
@@ -12,7 +12,6 @@
 #include <numeric>
 #include <regex>
 #include <sstream>
-#include <sys/time.h>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -26,6 +25,15 @@
 #include <upcxx/rput.hpp>
 #include <upcxx/upcxx.hpp>
 
+#include "adjacency_cache.hpp"
+#include "benchmark_harness.hpp"
+#include "csr_loader.hpp"
+#include "delegates.hpp"
+#include "flow_control.hpp"
+#include "instrumentation.hpp"
+#include "intersection.hpp"
+#include "owner_compute.hpp"
+
 #if defined NDEBUG
 const bool  debug{false};
 #else
@@ -44,134 +52,208 @@ typedef uint64_t           IndexType;
 using element                     = std::tuple<ve_type, ve_type>;
 using edge_list                   = std::vector<std::tuple<ve_type, ve_type>>;
 std::string edgelistFile          = "";
-uint64_t    num_vertices          = 0;
-uint64_t    num_vertices_per_rank = 0;
-
-double GetCurrentTime() {
-  static struct timeval  tv;
-  static struct timezone tz;
-  gettimeofday(&tv, &tz);
-  return tv.tv_sec + 1.e-6 * tv.tv_usec;
-}
-
-double TimeDifference(double& a, double& b) { return 1000 * (b - a); }
-
-double ElapsedMillis(double start, double stop) {
-  return TimeDifference(start, stop);
-}
-
-class counting_output_iterator
-    : public std::iterator<std::random_access_iterator_tag, size_t> {
-public:
-  counting_output_iterator(size_t& count) : count{count} {}
-  void                      operator++() {}
-  void                      operator++(int) {}
-  counting_output_iterator& operator*() { return *this; }
-  counting_output_iterator& operator[](size_t) { return *this; }
-
-  template<typename T>
-  void operator=(T) {
-    count++;
-  }
-  size_t get_count() { return count; }
-
-private:
-  size_t& count;
-};
-
-struct gptr_and_len {
-  global_ptr<uint64_t> p;    // pointer to first element in adjacencies
-  int                  n;    // number of elements
-};
-
-std::vector<upcxx::global_ptr<gptr_and_len>> bases;
-
-using BaseType = std::vector<upcxx::global_ptr<gptr_and_len>>;
+// Distribution of the vertices over ranks: cyclic, block or edge-block
+std::string partition = "cyclic";
+// Store only the forward adjacency in (degree, id) order, so that every
+// triangle is found exactly once.
+bool degreeOrdered = false;
+// Byte budget and eviction policy of the remote adjacency cache
+size_t      cacheMegabytes = 256;
+std::string cachePolicy    = "lru";
+// Cap on outstanding fetches, and vertices whose offsets are fetched per rget
+size_t maxInFlight = 4096;
+size_t offsetBlock = 1024;
+// Pull, push or choose per edge; hybrid pushes once the remote row is
+// pushRatio times the local one. Pushes are batched pushBatch IDs at a time.
+std::string mode      = "pull";
+double      pushRatio = 4;
+size_t      pushBatch = 1 << 16;
+// Replicate the rows of vertices of at least this degree on every rank (0:
+// never), or once per node
+uint64_t delegateDegree   = 0;
+bool     delegatesPerNode = false;
+
+// Warmup and timed repetitions, and where to write their times
+benchmark_options benchmarkOptions;
+
+// Counts the triangles of the loaded graph once, as one repetition.
+template <typename Id>
+void count_triangles_once(const distributed_csr<Id>& graph,
+                          const hub_delegates<Id>& hubs,
+                          benchmark_harness&       harness) {
+  harness.start("compute");
+  size_t   local_triangle_count = 0;
+  uint64_t delegate_lookups     = 0;
+  uint64_t delegate_bytes       = 0;
+  // Remote adjacency lists, fetched once and reused while they fit
+  using list_ptr = typename adjacency_cache<Id>::list_ptr;
+  adjacency_cache<Id> cache(graph, cacheMegabytes << 20,
+                            parse_cache_policy(cachePolicy), offsetBlock);
+  inflight_window     window(maxInFlight);
+  // Rows sent to the owners of their neighbors, and the hybrid-mode pushes
+  // decided in callbacks, which must not issue them (see push_deferred)
+  const execution_mode    how = parse_execution_mode(mode);
+  intersection_pusher<Id> pusher(graph, window, pushBatch);
+  std::vector<std::pair<uint64_t, uint64_t>> deferred;
+  auto push_deferred = [&]() {
+    for (const auto& d : deferred) pusher.push(d.first, d.second);
+    deferred.clear();
+  };
+  auto should_push = [&](size_t remote_len, size_t local_len) {
+    return remote_len >= pushRatio * local_len;
+  };
 
-uint64_t index_to_vertex_id(size_t index) {
-  // muliply for rows, add for row offset
-  return index * upcxx::rank_n() + upcxx::rank_me();
-}
-
-size_t vertex_id_to_index(uint64_t vertex_id) {
-  // It's ok to round off, as every vertex in a row in cyclic dist. will have the same index on every rank
-  return vertex_id / upcxx::rank_n();
-}
-
-auto print_graph() {
   // For each vertex
-  for (uint64_t i = 0; i < num_vertices_per_rank; i++) {
+  for (uint64_t i = 0; i < graph.num_vertices_per_rank; i++) {
     const auto vtx_ptr =
-        bases[upcxx::rank_me()].local()
-            [i];    // <--This gives the local ptr to the gbl ptr and length for a vtx
+        graph.local(i);    // <--This gives the local ptr to the gbl ptr and length for a vtx
     const auto adj_list_start = vtx_ptr.p.local();
     const auto adj_list_len   = vtx_ptr.n;
-    // std::cout << "Local vertex: " << i << " " << std::endl;
 
     auto current_vertex_id = index_to_vertex_id(i);
-
-    std::cout << "i = " << i << ", vertex id = " << current_vertex_id
-              << ", adjs: ";
     // For each neighbor of the vertex, get the adjacency  list and do the set intersection.
-    for (auto j = 0; j < vtx_ptr.n; j++) {
+    for (uint64_t j = 0; j < vtx_ptr.n; j++) {
       auto neighbor = adj_list_start[j];
-      std::cout << neighbor << ", ";
+      if (degreeOrdered || current_vertex_id < neighbor) {
+        auto rank   = vertex_id_to_rank(neighbor);
+        auto offset = vertex_id_to_offset(neighbor);
+        if (rank == upcxx::rank_me()) {
+          // Local neighbors need no fetch.
+          const auto& pn = graph.local(offset);
+          note_intersection(adj_list_len, pn.n);
+          local_triangle_count += intersect_count(adj_list_start, adj_list_len,
+                                                  pn.p.local(), pn.n);
+          continue;
+        }
+        const size_t hub = hubs.find(neighbor);
+        if (hub != hubs.npos) {
+          // Hubs are replicated on this rank (or node).
+          note_intersection(adj_list_len, hubs.degree(hub));
+          local_triangle_count +=
+              intersect_count(adj_list_start, adj_list_len, hubs.row(hub),
+                              hubs.degree(hub));
+          ++delegate_lookups;
+          delegate_bytes += hubs.degree(hub) * sizeof(Id);
+          continue;
+        }
+        if (how == execution_mode::push) {
+          pusher.push(i, neighbor);
+          continue;
+        }
+        auto pull = [=, &local_triangle_count](list_ptr two_hop_neighbor_list) {
+          note_intersection(adj_list_len, two_hop_neighbor_list->size());
+          local_triangle_count += intersect_count(
+              adj_list_start, adj_list_len, two_hop_neighbor_list->data(),
+              two_hop_neighbor_list->size());
+          if (debug) {
+            std::cout << "tc count (vertex_id = " << current_vertex_id
+                      << " x " << neighbor << " ): " << local_triangle_count
+                      << ", offset = " << offset << ", rank = " << rank
+                      << ". (";
+            std::copy(adj_list_start, adj_list_start + adj_list_len,
+                      std::ostream_iterator<double>(std::cout, ", "));
+            std::cout << ") XXX (";
+            std::copy(two_hop_neighbor_list->begin(),
+                      two_hop_neighbor_list->end(),
+                      std::ostream_iterator<double>(std::cout, ", "));
+            std::cout << ")" << std::endl;
+          }
+        };
+        if (how == execution_mode::pull) {
+          window.track(cache.fetch(neighbor).then(pull));
+          continue;
+        }
+        // hybrid: decide now if the neighbor's degree is known, else once
+        // its offsets arrive
+        auto&            offsets = cache.offsets_of_lists();
+        gptr_and_len<Id> known;
+        if (offsets.find(neighbor, known)) {
+          if (should_push(known.n, adj_list_len)) {
+            pusher.push(i, neighbor);
+          } else {
+            window.track(cache.fetch(neighbor).then(pull));
+          }
+          continue;
+        }
+        window.track(offsets.fetch(neighbor).then(
+            [=, &cache, &deferred](gptr_and_len<Id> pn) {
+              if (should_push(pn.n, adj_list_len)) {
+                deferred.emplace_back(i, neighbor);
+                return upcxx::make_future();
+              }
+              return cache.fetch(neighbor).then(pull);
+            }));
+      }
     }
-    std::cout << std::endl;
+    push_deferred();
+    // periodically call progress to allow incoming RPCs to be processed
+    if (i % 10 == 0) upcxx::progress();
   }
-}
-
-auto vertex_id_to_rank(uint64_t v_id) { return v_id % upcxx::rank_n(); }
-
-auto vertex_id_to_offset(uint64_t v_id) { return v_id / upcxx::rank_n(); }
-
-void init_adjs(std::istream& infile, BaseType& bases) {
-  infile.read(reinterpret_cast<char*>(&num_vertices), sizeof(num_vertices));
-  std::cout << num_vertices << std::endl;
-
-  bases.reserve(upcxx::rank_n());
-  num_vertices_per_rank =
-      (num_vertices + upcxx::rank_n() - 1 - upcxx::rank_me()) / upcxx::rank_n();
-  std::cout << "No of vertices per rank: " << num_vertices_per_rank
-            << std::endl;
-  bases[upcxx::rank_me()] =
-      upcxx::new_array<gptr_and_len>(num_vertices_per_rank);
-
-  for (int r = 0; r < upcxx::rank_n(); r++) {
-    bases[r] = upcxx::broadcast(bases[r], r).wait();
+  // wait for the outstanding fetches and pushes to complete
+  do {
+    push_deferred();
+    pusher.flush();
+    window.drain();
+  } while (!deferred.empty());
+  local_triangle_count += pusher.count();
+  {
+    // other ranks may still push to this one
+    blocked_scope blocked;
+    upcxx::barrier();
   }
+  harness.stop();
+  dout << "Local triangle count: " << local_triangle_count << std::endl;
+  dout << "Starting reduction " <<std::endl;
 
-  for (uint64_t i = upcxx::rank_me(); i < num_vertices; i += upcxx::rank_n()) {
-    gptr_and_len pn;
-    uint64_t     adj_indices[2];
-    const auto   index_seekg = 1 + i;
-    infile.seekg(index_seekg * sizeof(uint64_t), infile.beg);
-    infile.read(reinterpret_cast<char*>(adj_indices), 2 * sizeof(uint64_t));
-    auto cur_adj_len = adj_indices[1] - adj_indices[0];
-    pn.n             = cur_adj_len;
-    pn.p                      = upcxx::new_array<uint64_t>(cur_adj_len);
-    const auto adj_list_seekg = 2 + num_vertices + adj_indices[0];
-    infile.seekg(adj_list_seekg * sizeof(uint64_t), infile.beg);
-    infile.read(reinterpret_cast<char*>(pn.p.local()),
-                cur_adj_len * sizeof(uint64_t));
-
-    const auto base_index                       = vertex_id_to_index(i);
-    bases[upcxx::rank_me()].local()[base_index] = pn;
+  harness.start("reduce");
+  size_t total_triangle_count = 0;
+  // Reduce the result
+  dout << "Final local count: " << local_triangle_count << std::endl;
+  auto done_reduction =
+      upcxx::reduce_one(&local_triangle_count, &total_triangle_count, 1,
+                        [](size_t a, size_t b) { return a + b; }, 0);
+  done_reduction.wait();
+  harness.stop();
+  if (!harness.last_repetition()) return;
+  if (upcxx::rank_me() == 0) {
+    const double elapsed =
+        1000 * (harness.seconds("compute") + harness.seconds("reduce"));
+    // Without the orientation every triangle is found from each of its edges
+    const size_t copies = degreeOrdered ? 1 : 3;
+    std::cout << "Total no of triangles: " << total_triangle_count / copies
+              << " counted in " << elapsed << " ms." << std::endl;
+    if (total_triangle_count % copies > 0) {
+      std::cout << "WARNING: " << total_triangle_count % copies << " remaining."
+                << std::endl;
+    }
+    harness.metric("triangles", total_triangle_count / copies);
   }
+  report_cache_stats(cache.stats());
+  report_push_stats(pusher);
+  report_delegate_stats(hubs, delegate_lookups, delegate_bytes);
 }
 
-void readBinaryFormat(const std::string& filename, BaseType& bases) {
-  std::ifstream inputFile;
-  inputFile.exceptions(std::ifstream::failbit);
-  try {
-    inputFile.open(filename);
-    init_adjs(inputFile, bases);
-    inputFile.close();
-  } catch (std::ios_base::failure& fail) {
-    std::cerr << "Something went wrong with reading the matrix from file "
-              << filename << std::endl;
-    throw fail;
-  }
+// Loads the graph with Id-wide vertex IDs and counts its triangles.
+template <typename Id>
+void count_triangles() {
+  benchmark_harness harness("triangle_counting", edgelistFile,
+                            benchmarkOptions);
+  harness.start("load");
+  distributed_csr<Id> graph;
+  readBinaryFormat(edgelistFile, graph,
+                   degreeOrdered ? csr_orientation::degree_ordered
+                                 : csr_orientation::symmetric,
+                   parse_partition_kind(partition));
+  hub_delegates<Id> hubs(edgelistFile, delegateDegree,
+                         degreeOrdered ? csr_orientation::degree_ordered
+                                       : csr_orientation::symmetric,
+                         delegatesPerNode);
+  harness.stop();
+
+  // print_graph(graph);
+
+  while (harness.next_repetition()) count_triangles_once(graph, hubs, harness);
+  harness.report();
 }
 
 int main(int argc, char* argv[]) {
@@ -182,106 +264,71 @@ int main(int argc, char* argv[]) {
 
   while (argIndex < argc) {
     std::string arg(argv[argIndex]);
+    if (parse_benchmark_option(argv, argIndex, benchmarkOptions)) continue;
     if (arg == "--edgelistfile") {
       ++argIndex;
       edgelistFile = std::string(argv[argIndex]);
       ++argIndex;
     }
-  }
-
-  readBinaryFormat(edgelistFile, bases);
-
-  // print_graph();
-
-  upcxx::barrier();
-
-  // the start of the conjoined future
-  upcxx::future<> fut_all = upcxx::make_future();
-  double          start{0};
-  double          stop{0};
-  if (upcxx::rank_me() == 0) start = GetCurrentTime();
-
-  size_t                   local_triangle_count = 0;
-  counting_output_iterator counter(local_triangle_count);
-
-  // For each vertex
-  for (uint64_t i = 0; i < num_vertices_per_rank; i++) {
-    const auto vtx_ptr =
-        bases[upcxx::rank_me()].local()
-            [i];    // <--This gives the local ptr to the gbl ptr and length for a vtx
-    const auto adj_list_start = vtx_ptr.p.local();
-    const auto adj_list_len   = vtx_ptr.n;
-
-    auto current_vertex_id = index_to_vertex_id(i);
-    // For each neighbor of the vertex, get the adjacency  list and do the set intersection.
-    for (auto j = 0; j < vtx_ptr.n; j++) {
-      auto neighbor = adj_list_start[j];
-      if (current_vertex_id < neighbor) {
-        auto            rank   = vertex_id_to_rank(neighbor);
-        auto            offset = vertex_id_to_offset(neighbor);
-        upcxx::future<> fut =
-            upcxx::rget(bases[rank] + offset)
-                .then([=, &local_triangle_count](
-                          gptr_and_len pn) {
-                  // Allocate a buffer of the same size
-                  std::vector<uint64_t> two_hop_neighbor_list(pn.n);
-                  // rget the actual list
-                  return upcxx::rget(pn.p, two_hop_neighbor_list.data(), pn.n)
-                      .then([=,
-                             two_hop_neighbor_list =
-                                 std::move(two_hop_neighbor_list),
-                             &local_triangle_count]() {
-                        std::set_intersection(
-                            adj_list_start, adj_list_start + adj_list_len,
-                            two_hop_neighbor_list.begin(),
-                            two_hop_neighbor_list.end(), counter);
-                        if (debug) {
-                          std::cout
-                              << "tc count (vertex_id = " << current_vertex_id
-                              << " x " << neighbor
-                              << " ): " << local_triangle_count
-                              << ", offset = " << offset << ", rank = " << rank
-                              << ". (";
-                          std::copy(
-                              adj_list_start, adj_list_start + adj_list_len,
-                              std::ostream_iterator<double>(std::cout, ", "));
-                          std::cout << ") XXX (";
-                          std::copy(
-                              two_hop_neighbor_list.begin(),
-                              two_hop_neighbor_list.end(),
-                              std::ostream_iterator<double>(std::cout, ", "));
-                          std::cout << ")" << std::endl;
-                        }
-                      });
-                });
-        // conjoin the futures
-        fut_all = upcxx::when_all(fut_all, fut);
-        // periodically call progress to allow incoming RPCs to be processed
-        if (i % 10 == 0) upcxx::progress();
-      }
+    if (arg == "--partition") {
+      ++argIndex;
+      partition = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--degree-order") {
+      ++argIndex;
+      degreeOrdered = true;
+    }
+    if (arg == "--cache-mb") {
+      ++argIndex;
+      cacheMegabytes = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--cache-policy") {
+      ++argIndex;
+      cachePolicy = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--max-inflight") {
+      ++argIndex;
+      maxInFlight = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--offset-block") {
+      ++argIndex;
+      offsetBlock = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--mode") {
+      ++argIndex;
+      mode = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--push-ratio") {
+      ++argIndex;
+      pushRatio = std::stod(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--push-batch") {
+      ++argIndex;
+      pushBatch = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--delegate-degree") {
+      ++argIndex;
+      delegateDegree = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--delegates-per-node") {
+      ++argIndex;
+      delegatesPerNode = true;
     }
   }
-  // wait for all the conjoined futures to complete
-  fut_all.wait();
-  dout << "Local triangle count: " << local_triangle_count << std::endl;
-  dout << "Starting reduction " <<std::endl;
 
-  size_t total_triangle_count = 0;
-  // Reduce the result
-  dout << "Final local count: " << local_triangle_count << std::endl;
-  auto done_reduction =
-      upcxx::reduce_one(&local_triangle_count, &total_triangle_count, 1,
-                        [](size_t a, size_t b) { return a + b; }, 0);
-  done_reduction.wait();
-  if (upcxx::rank_me() == 0) {
-    stop          = GetCurrentTime();
-    float elapsed = ElapsedMillis(start, stop);
-    std::cout << "Total no of triangles: " << total_triangle_count / 3
-              << " counted in " << elapsed << " ms." << std::endl;
-    if (total_triangle_count % 3 > 0) {
-      std::cout << "WARNING: " << total_triangle_count % 3 << " remaining."
-                << std::endl;
-    }
+  if (use_32bit_ids(edgelistFile)) {
+    count_triangles<uint32_t>();
+  } else {
+    count_triangles<uint64_t>();
   }
 
   upcxx::finalize();
@@ -12,18 +12,14 @@
 #include <numeric>
 #include <regex>
 #include <sstream>
-#include <sys/time.h>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
-#define RUNOMP 1
+#include <atomic>
 
-#ifdef RUNOMP
 #include <omp.h>
-#endif
-
-
 
 #include <upcxx/allocate.hpp>
 #include <upcxx/atomic.hpp>
@@ -34,6 +30,12 @@
 #include <upcxx/rput.hpp>
 #include <upcxx/upcxx.hpp>
 
+#include "adjacency_cache.hpp"
+#include "benchmark_harness.hpp"
+#include "csr_loader.hpp"
+#include "intersection.hpp"
+#include "offnode_fetcher.hpp"
+
 
 // #include "compressed.hpp"
 using namespace upcxx;
@@ -44,135 +46,179 @@ typedef uint64_t           IndexType;
 using element                     = std::tuple<ve_type, ve_type>;
 using edge_list                   = std::vector<std::tuple<ve_type, ve_type>>;
 std::string edgelistFile          = "";
-uint64_t    num_vertices          = 0;
-uint64_t    num_vertices_per_rank = 0;
-
-double GetCurrentTime() {
-  static struct timeval  tv;
-  static struct timezone tz;
-  gettimeofday(&tv, &tz);
-  return tv.tv_sec + 1.e-6 * tv.tv_usec;
-}
-
-double TimeDifference(double& a, double& b) { return 1000 * (b - a); }
-
-double ElapsedMillis(double start, double stop) {
-  return TimeDifference(start, stop);
-}
-
-class counting_output_iterator
-    : public std::iterator<std::random_access_iterator_tag, size_t> {
-public:
-  counting_output_iterator(size_t& count) : count{count} {}
-  void                      operator++() {}
-  void                      operator++(int) {}
-  counting_output_iterator& operator*() { return *this; }
-  counting_output_iterator& operator[](size_t) { return *this; }
-
-  template<typename T>
-  void operator=(T) {
-    //     #pragma omp atomic
-    count++;
+// Distribution of the vertices over ranks: cyclic, block or edge-block
+std::string partition = "cyclic";
+// Store only the forward adjacency in (degree, id) order, so that every
+// triangle is found exactly once.
+bool degreeOrdered = false;
+// Byte budget of the off-node adjacency cache, and cap on outstanding fetches
+size_t cacheMegabytes = 256;
+size_t maxInFlight    = 4096;
+// Vertices a worker thread takes at a time
+const uint64_t vertex_chunk = 100;
+
+// Warmup and timed repetitions, and where to write their times
+benchmark_options benchmarkOptions;
+
+// Counts the triangles of the loaded graph once, as one repetition.
+template <typename Id>
+void count_triangles_once(const distributed_csr<Id>& graph,
+                          benchmark_harness&         harness) {
+  harness.start("compute");
+  // Rows of the ranks on this node are read in place through shared memory;
+  // rows of other nodes are fetched by the communication thread.
+  std::vector<const uint64_t*> node_offsets(upcxx::rank_n(), nullptr);
+  std::vector<const Id*>       node_segments(upcxx::rank_n(), nullptr);
+  for (upcxx::intrank_t r = 0; r < upcxx::rank_n(); r++) {
+    if (upcxx::local_team_contains(r)) {
+      node_offsets[r]  = graph.offsets[r].local();
+      node_segments[r] = graph.segments[r].local();
+    }
   }
-  size_t get_count() { return count; }
-
-private:
-  size_t& count;
-};
-
-struct gptr_and_len {
-  global_ptr<uint64_t> p;    // pointer to first element in adjacencies
-  int                  n;    // number of elements
-};
-
-std::vector<upcxx::global_ptr<gptr_and_len>> bases;
-
-using BaseType = std::vector<upcxx::global_ptr<gptr_and_len>>;
-
-uint64_t index_to_vertex_id(size_t index) {
-  // muliply for rows, add for row offset
-  return index * upcxx::rank_n() + upcxx::rank_me();
-}
-
-size_t vertex_id_to_index(uint64_t vertex_id) {
-  // It's ok to round off, as every vertex in a row in cyclic dist. will have the same index on every rank
-  return vertex_id / upcxx::rank_n();
-}
-
-auto print_graph() {
-  // For each vertex
-  for (uint64_t i = 0; i < num_vertices_per_rank; i++) {
-    const auto vtx_ptr =
-        bases[upcxx::rank_me()].local()
-            [i];    // <--This gives the local ptr to the gbl ptr and length for a vtx
-    const auto adj_list_start = vtx_ptr.p.local();
-    const auto adj_list_len   = vtx_ptr.n;
-    // std::cout << "Local vertex: " << i << " " << std::endl;
-
-    auto current_vertex_id = index_to_vertex_id(i);
+  adjacency_cache<Id> cache(graph, cacheMegabytes << 20);
+  using request = typename offnode_fetcher<Id>::request;
+  using ready   = typename offnode_fetcher<Id>::ready;
+  // Thread 0 holds the master persona and is the communication thread; the
+  // others are workers. With a single thread, thread 0 plays both roles.
+  offnode_fetcher<Id>   fetcher(cache, maxInFlight);
+  std::atomic<uint64_t> next_vertex{0};
+
+  size_t   local_triangle_count = 0;
+  uint64_t on_node              = 0;
+  uint64_t off_node             = 0;
+
+#pragma omp parallel reduction(+ : local_triangle_count, on_node, off_node)
+  {
+    // The team may be smaller than omp_get_max_threads() (OMP_DYNAMIC,
+    // OMP_THREAD_LIMIT, nesting), so the workers are counted from it.
+    const int threads = omp_get_num_threads();
+#pragma omp single
+    {
+      fetcher.set_workers(threads == 1 ? 1 : threads - 1);
+      if (upcxx::rank_me() == 0) {
+        std::cout << " Total #Threads = " << threads << std::endl;
+      }
+    }
+    const bool communicates = omp_get_thread_num() == 0;
+    bool       works        = !communicates || threads == 1;
+
+    std::vector<request> requests;
+    std::vector<ready>   arrived;
+    for (;;) {
+      if (works) {
+        const uint64_t first = next_vertex.fetch_add(vertex_chunk);
+        if (first >= graph.num_vertices_per_rank) {
+          fetcher.finish_requests();
+          works = false;
+        }
+        const uint64_t last =
+            std::min(first + vertex_chunk, graph.num_vertices_per_rank);
+        // For each vertex
+        for (uint64_t i = first; i < last; i++) {
+          const auto vtx_ptr =
+              graph.local(i);    // <--This gives the local ptr to the gbl ptr and length for a vtx
+          const auto adj_list_start = vtx_ptr.p.local();
+          const auto adj_list_len   = vtx_ptr.n;
+          // Long dense rows get a bitmap that every neighbor's row probes.
+          row_intersector<Id> row(adj_list_start, adj_list_len);
+
+          auto current_vertex_id = index_to_vertex_id(i);
+          // For each neighbor of the vertex, get the adjacency  list and do the set intersection.
+          for (uint64_t j = 0; j < vtx_ptr.n; j++) {
+            auto neighbor = adj_list_start[j];
+            if (degreeOrdered || current_vertex_id < neighbor) {
+              auto rank = vertex_id_to_rank(neighbor);
+              if (node_offsets[rank]) {
+                const uint64_t* bounds =
+                    node_offsets[rank] + vertex_id_to_offset(neighbor);
+                local_triangle_count += row.count(
+                    node_segments[rank] + bounds[0], bounds[1] - bounds[0]);
+                ++on_node;
+              } else {
+                requests.push_back(request{i, neighbor});
+                ++off_node;
+              }
+            }
+          }
+        }
+        fetcher.submit(requests);
+      }
 
-    std::cout << "i = " << i << ", vertex id = " << current_vertex_id
-              << ", adjs: ";
-    // For each neighbor of the vertex, get the adjacency  list and do the set intersection.
-    for (auto j = 0; j < vtx_ptr.n; j++) {
-      auto neighbor = adj_list_start[j];
-      std::cout << neighbor << ", ";
+      if (communicates) fetcher.service();
+      // The communication thread leaves the arrived lists to the workers
+      // until every fetch is done, so that it keeps issuing.
+      const bool finished = fetcher.done();
+      if ((!communicates || threads == 1 || finished) &&
+          fetcher.take(arrived)) {
+        for (const ready& a : arrived) {
+          const auto& pn = graph.local(a.source_index);
+          local_triangle_count += intersect_count(pn.p.local(), pn.n,
+                                                  a.list->data(), a.list->size());
+        }
+        arrived.clear();
+      } else if (finished && !works) {
+        break;
+      } else if (!works && !communicates) {
+        // Idle until more lists arrive; leave the core to the others.
+        std::this_thread::yield();
+      }
     }
-    std::cout << std::endl;
   }
-}
-
-auto vertex_id_to_rank(uint64_t v_id) { return v_id % upcxx::rank_n(); }
 
-auto vertex_id_to_offset(uint64_t v_id) { return v_id / upcxx::rank_n(); }
+  harness.stop();
 
-void init_adjs(std::istream& infile, BaseType& bases) {
-  infile.read(reinterpret_cast<char*>(&num_vertices), sizeof(num_vertices));
-  std::cout << num_vertices << std::endl;
-
-  bases.reserve(upcxx::rank_n());
-  num_vertices_per_rank =
-      (num_vertices + upcxx::rank_n() - 1 - upcxx::rank_me()) / upcxx::rank_n();
-  std::cout << "No of vertices per rank: " << num_vertices_per_rank
-            << std::endl;
-  bases[upcxx::rank_me()] =
-      upcxx::new_array<gptr_and_len>(num_vertices_per_rank);
-
-  for (int r = 0; r < upcxx::rank_n(); r++) {
-    bases[r] = upcxx::broadcast(bases[r], r).wait();
+  harness.start("reduce");
+  size_t total_triangle_count = 0;
+  // Reduce the result
+  auto done_reduction =
+      upcxx::reduce_one(&local_triangle_count, &total_triangle_count, 1,
+                        [](size_t a, size_t b) { return a + b; }, 0);
+  done_reduction.wait();
+  harness.stop();
+  if (!harness.last_repetition()) return;
+  if (upcxx::rank_me() == 0) {
+    const double elapsed =
+        1000 * (harness.seconds("compute") + harness.seconds("reduce"));
+    // Without the orientation every triangle is found from each of its edges
+    const size_t copies = degreeOrdered ? 1 : 3;
+    std::cout << "Total no of triangles: " << total_triangle_count / copies
+              << " counted in " << elapsed << " ms." << std::endl;
+    if (total_triangle_count % copies > 0) {
+      std::cout << "WARNING: " << total_triangle_count % copies << " remaining."
+                << std::endl;
+    }
+    harness.metric("triangles", total_triangle_count / copies);
   }
 
-  for (uint64_t i = upcxx::rank_me(); i < num_vertices; i += upcxx::rank_n()) {
-    gptr_and_len pn;
-    uint64_t     adj_indices[2];
-    const auto   index_seekg = 1 + i;
-    infile.seekg(index_seekg * sizeof(uint64_t), infile.beg);
-    infile.read(reinterpret_cast<char*>(adj_indices), 2 * sizeof(uint64_t));
-    auto cur_adj_len = adj_indices[1] - adj_indices[0];
-    pn.n             = cur_adj_len;
-    pn.p                      = upcxx::new_array<uint64_t>(cur_adj_len);
-    const auto adj_list_seekg = 2 + num_vertices + adj_indices[0];
-    infile.seekg(adj_list_seekg * sizeof(uint64_t), infile.beg);
-    infile.read(reinterpret_cast<char*>(pn.p.local()),
-                cur_adj_len * sizeof(uint64_t));
-
-    const auto base_index                       = vertex_id_to_index(i);
-    bases[upcxx::rank_me()].local()[base_index] = pn;
+  const uint64_t pairs[2] = {on_node, off_node};
+  uint64_t       total_pairs[2] = {0, 0};
+  upcxx::reduce_one(pairs, total_pairs, 2,
+                    [](uint64_t a, uint64_t b) { return a + b; }, 0)
+      .wait();
+  if (upcxx::rank_me() == 0) {
+    std::cout << "Intersections: " << total_pairs[0] << " on node, "
+              << total_pairs[1] << " off node" << std::endl;
   }
+  report_cache_stats(cache.stats());
 }
 
-void readBinaryFormat(const std::string& filename, BaseType& bases) {
-  std::ifstream inputFile;
-  inputFile.exceptions(std::ifstream::failbit);
-  try {
-    inputFile.open(filename);
-    init_adjs(inputFile, bases);
-    inputFile.close();
-  } catch (std::ios_base::failure& fail) {
-    std::cerr << "Something went wrong with reading the matrix from file "
-              << filename << std::endl;
-    throw fail;
-  }
+// Loads the graph with Id-wide vertex IDs and counts its triangles.
+template <typename Id>
+void count_triangles() {
+  benchmark_harness harness("triangle_counting_shared", edgelistFile,
+                            benchmarkOptions);
+  harness.start("load");
+  distributed_csr<Id> graph;
+  readBinaryFormat(edgelistFile, graph,
+                   degreeOrdered ? csr_orientation::degree_ordered
+                                 : csr_orientation::symmetric,
+                   parse_partition_kind(partition));
+  harness.stop();
+
+  // print_graph(graph);
+
+  while (harness.next_repetition()) count_triangles_once(graph, harness);
+  harness.report();
 }
 
 int main(int argc, char* argv[]) {
@@ -183,85 +229,37 @@ int main(int argc, char* argv[]) {
 
   while (argIndex < argc) {
     std::string arg(argv[argIndex]);
+    if (parse_benchmark_option(argv, argIndex, benchmarkOptions)) continue;
     if (arg == "--edgelistfile") {
       ++argIndex;
       edgelistFile = std::string(argv[argIndex]);
       ++argIndex;
     }
-  }
-
-  readBinaryFormat(edgelistFile, bases);
-
-  // print_graph();
-
-  upcxx::barrier();
-
-  // the start of the conjoined future
-  upcxx::future<> fut_all = upcxx::make_future();
-  double          start{0};
-  double          stop{0};
-  if (upcxx::rank_me() == 0) start = GetCurrentTime();
-
-  size_t                   local_triangle_count = 0;
-  
-
-#ifdef RUNOMP
-#pragma omp parallel 
-{
-  auto tid = omp_get_thread_num();
-  if (tid == 0)
-    std::cout << " Total #Threads = "<< omp_get_num_threads() << std::endl;
-  // schedule(static,1) // schedule(dynamic, 10)
-
-#pragma omp for schedule(dynamic, 100)  reduction(+:local_triangle_count)
-#endif
-  // For each vertex
-  for (uint64_t i = 0; i < num_vertices_per_rank; i++) {
-    counting_output_iterator counter(local_triangle_count);
-    const auto vtx_ptr =
-        bases[upcxx::rank_me()].local()
-            [i];    // <--This gives the local ptr to the gbl ptr and length for a vtx
-    const auto adj_list_start = vtx_ptr.p.local();
-    const auto adj_list_len   = vtx_ptr.n;
-    // std::cout << "Local vertex: " << i << " " << std::endl;
-
-    auto current_vertex_id = index_to_vertex_id(i);
-    // For each neighbor of the vertex, get the adjacency  list and do the set intersection.
-    for (auto j = 0; j < vtx_ptr.n; j++) {
-      auto neighbor = adj_list_start[j];
-      if (current_vertex_id < neighbor) {
-	// Since everything is local, following the same procedure as parent vtx to get 2-hop neighbor
-	const auto vtx_ptr_nbr =
-	  bases[upcxx::rank_me()].local()[neighbor];
-	const auto adj_list_nbr_start = vtx_ptr_nbr.p.local();
-	const auto adj_list_nbr_len   = vtx_ptr_nbr.n;
-	
-	std::set_intersection(adj_list_start, adj_list_start + adj_list_len,
-			      adj_list_nbr_start,
-			      adj_list_nbr_start + adj_list_nbr_len, counter);
-      }
+    if (arg == "--partition") {
+      ++argIndex;
+      partition = std::string(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--degree-order") {
+      ++argIndex;
+      degreeOrdered = true;
+    }
+    if (arg == "--cache-mb") {
+      ++argIndex;
+      cacheMegabytes = std::stoull(argv[argIndex]);
+      ++argIndex;
+    }
+    if (arg == "--max-inflight") {
+      ++argIndex;
+      maxInFlight = std::stoull(argv[argIndex]);
+      ++argIndex;
     }
   }
-#ifdef RUNOMP
- }
-#endif
 
-  // if (rank_me() == 0) {
-  size_t total_triangle_count = 0;
-  // Reduce the result
-  auto done_reduction =
-      upcxx::reduce_one(&local_triangle_count, &total_triangle_count, 1,
-                        [](size_t a, size_t b) { return a + b; }, 0);
-  done_reduction.wait();
-  if (upcxx::rank_me() == 0) {
-    stop          = GetCurrentTime();
-    float elapsed = ElapsedMillis(start, stop);
-    std::cout << "Total no of triangles: " << total_triangle_count / 3
-              << " counted in " << elapsed << " ms." << std::endl;
-    if (total_triangle_count % 3 > 0) {
-      std::cout << "WARNING: " << total_triangle_count % 3 << " remaining."
-                << std::endl;
-    }
+  if (use_32bit_ids(edgelistFile)) {
+    count_triangles<uint32_t>();
+  } else {
+    count_triangles<uint64_t>();
   }
 
   upcxx::finalize();